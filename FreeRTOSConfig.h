@@ -76,14 +76,21 @@
 #define configAPPLICATION_ALLOCATED_HEAP        0
 
 /* Hook function related definitions. */
-#define configCHECK_FOR_STACK_OVERFLOW          0
+/* 2: the end of each stack is also checked for its fill pattern on a switch,
+   vApplicationStackOverflowHook() (freertos_hook.c) halts */
+#define configCHECK_FOR_STACK_OVERFLOW          2
 #define configUSE_MALLOC_FAILED_HOOK            0
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
+/* microseconds of the system timer (freertos_hook.c), wraps after 71 minutes */
+#include <stdint.h>
+uint32_t xvc_run_time_us(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()        xvc_run_time_us()
 
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
@@ -104,7 +111,11 @@
 
 #if FREE_RTOS_KERNEL_SMP // set by the RP2040 SMP port of FreeRTOS
 /* SMP port only */
-#define configNUM_CORES                         1
+/* XVC_NUM_CORES comes from the XVC_SMP cmake option */
+#ifndef XVC_NUM_CORES
+#define XVC_NUM_CORES                           1
+#endif
+#define configNUM_CORES                         XVC_NUM_CORES
 #define configTICK_CORE                         0
 #define configRUN_MULTIPLE_PRIORITIES           1
 #define configUSE_CORE_AFFINITY                 1
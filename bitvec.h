@@ -0,0 +1,64 @@
+#ifndef __BITVEC_H__
+#define __BITVEC_H__
+
+#include <stdint.h>
+
+// LSB first bit vectors in 32 bit words, the layout of the XVC tms/tdi/tdo
+// buffers and of the PIO fifo words.
+
+static inline int bitvec_get(const uint32_t *v, int i)
+{
+    return (v[i >> 5] >> (i & 31)) & 1;
+}
+
+// dst[0..n) = src[off..off+n), the bits above n in the last word are zero
+static inline void bitvec_extract(uint32_t *dst, const uint32_t *src, int off, int n)
+{
+    const uint32_t *s = src + (off >> 5);
+    int sh = off & 31;
+    int words = (n + 31) / 32;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t v = s[w] >> sh;
+        // only touch the next source word when bits are needed from it
+        if (sh && n - 32 * w > 32 - sh)
+            v |= s[w + 1] << (32 - sh);
+        dst[w] = v;
+    }
+    if (n & 31)
+        dst[words - 1] &= (1u << (n & 31)) - 1;
+}
+
+// dst[off..off+n) = src[0..n), other bits of dst are kept
+static inline void bitvec_insert(uint32_t *dst, int off, const uint32_t *src, int n)
+{
+    for (int i = 0; i < n; i += 32)
+    {
+        int len = n - i < 32 ? n - i : 32;
+        uint32_t v = src[i >> 5];
+        uint32_t mask = len == 32 ? 0xffffffffu : (1u << len) - 1;
+        int pos = off + i, sh = pos & 31;
+        uint32_t *d = dst + (pos >> 5);
+        d[0] = (d[0] & ~(mask << sh)) | ((v & mask) << sh);
+        if (sh && len > 32 - sh)
+            d[1] = (d[1] & ~(mask >> (32 - sh))) | ((v & mask) >> (32 - sh));
+    }
+}
+
+// dst[off..off+n) = bit
+static inline void bitvec_fill(uint32_t *dst, int off, int n, int bit)
+{
+    while (n > 0)
+    {
+        int sh = off & 31, len = 32 - sh < n ? 32 - sh : n;
+        uint32_t mask = (len == 32 ? 0xffffffffu : (1u << len) - 1) << sh;
+        if (bit)
+            dst[off >> 5] |= mask;
+        else
+            dst[off >> 5] &= ~mask;
+        off += len;
+        n -= len;
+    }
+}
+
+#endif
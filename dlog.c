@@ -0,0 +1,98 @@
+#include "dlog.h"
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef DLOG_BINARY
+#define DLOG_BINARY 0
+#endif
+#define DLOG_RING_SIZE 256 // records, power of two
+#define DLOG_DRAIN_MS 20
+
+static const char *const dlog_fmt[DLOG_ID_COUNT] = {
+#define DLOG_ID(name, fmt) fmt,
+#include "dlog_ids.h"
+#undef DLOG_ID
+};
+
+static dlog_rec_t ring[DLOG_RING_SIZE];
+static volatile uint32_t head, tail;
+static uint32_t dropped;
+static spin_lock_t *lock;
+
+void dlog_init(void)
+{
+    lock = spin_lock_init(spin_lock_claim_unused(true));
+}
+
+void dlog_put(uint16_t id, uint32_t a, uint32_t b)
+{
+    uint32_t ts = time_us_32();
+    uint32_t save = spin_lock_blocking(lock);
+    if (head - tail >= DLOG_RING_SIZE)
+    {
+        dropped++;
+    }
+    else
+    {
+        dlog_rec_t *r = &ring[head % DLOG_RING_SIZE];
+        r->ts_us = ts;
+        r->id = id;
+        r->core = get_core_num();
+        r->arg[0] = a;
+        r->arg[1] = b;
+        head++;
+    }
+    spin_unlock(lock, save);
+}
+
+static void dlog_emit(const dlog_rec_t *r)
+{
+#if DLOG_BINARY
+    static const uint8_t sync[2] = {DLOG_SYNC0, DLOG_SYNC1};
+    uart_write_blocking(uart_default, sync, sizeof(sync));
+    uart_write_blocking(uart_default, (const uint8_t *)r, sizeof(*r));
+#else
+    printf("[%lu.%06lu %u] ", (unsigned long)(r->ts_us / 1000000), (unsigned long)(r->ts_us % 1000000), r->core);
+    if (r->id < DLOG_ID_COUNT)
+        printf(dlog_fmt[r->id], r->arg[0], r->arg[1]);
+    else
+        printf("unknown id %u", r->id);
+    printf("\n");
+#endif
+}
+
+static void dlog_task(void *param)
+{
+    (void)param;
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_MS));
+        while (tail != head)
+        {
+            // the dropped count is shared with the writers
+            dlog_rec_t r;
+            uint32_t save = spin_lock_blocking(lock);
+            r = ring[tail % DLOG_RING_SIZE];
+            tail++;
+            uint32_t lost = dropped;
+            dropped = 0;
+            spin_unlock(lock, save);
+            dlog_emit(&r);
+            if (lost)
+            {
+                dlog_rec_t d = {.ts_us = r.ts_us, .id = DLOG_DROPPED, .core = r.core, .arg = {lost, 0}};
+                dlog_emit(&d);
+            }
+        }
+    }
+}
+
+void dlog_start(void)
+{
+    (void)xTaskCreate(dlog_task, "dlog", configMINIMAL_STACK_SIZE, NULL, 1, NULL);
+}
@@ -0,0 +1,50 @@
+#ifndef __DLOG_H__
+#define __DLOG_H__
+
+#include <stdint.h>
+
+// Deferred logging: DLOGn() stores a 16 byte record in a RAM ring, from any
+// task, core or ISR, and a low priority task drains it to the uart later.
+// The drainer prints text, or with DLOG_BINARY=1 sends raw records that
+// host/dlog_decode turns back into text.
+
+enum
+{
+#define DLOG_ID(name, fmt) DLOG_##name,
+#include "dlog_ids.h"
+#undef DLOG_ID
+    DLOG_ID_COUNT
+};
+
+// binary stream: DLOG_SYNC0 DLOG_SYNC1 then the record, little endian
+#define DLOG_SYNC0 0xa5
+#define DLOG_SYNC1 0x5a
+
+typedef struct dlog_rec
+{
+    uint32_t ts_us;
+    uint16_t id;
+    uint16_t core;
+    uint32_t arg[2];
+} dlog_rec_t;
+
+#ifndef DLOG_ENABLE
+#define DLOG_ENABLE 1
+#endif
+
+#if DLOG_ENABLE
+#define DLOG0(name) dlog_put(DLOG_##name, 0, 0)
+#define DLOG1(name, a) dlog_put(DLOG_##name, (uint32_t)(a), 0)
+#define DLOG2(name, a, b) dlog_put(DLOG_##name, (uint32_t)(a), (uint32_t)(b))
+#else
+#define DLOG0(name) ((void)0)
+#define DLOG1(name, a) ((void)(a))
+#define DLOG2(name, a, b) ((void)(a), (void)(b))
+#endif
+
+void dlog_init(void);
+void dlog_put(uint16_t id, uint32_t a, uint32_t b);
+// creates the drainer task, priority just above idle
+void dlog_start(void);
+
+#endif
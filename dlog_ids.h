@@ -0,0 +1,32 @@
+// Deferred log message table, shared by the firmware and host/dlog_decode.
+// DLOG_ID(name, format): format takes at most two 32 bit integer arguments.
+// Only append, the host decoder looks records up by position.
+DLOG_ID(DROPPED, "dlog: %u records dropped")
+DLOG_ID(LINK_NOT_READY, "linkoutput: usb not ready")
+DLOG_ID(USB_RECV_BUSY, "usb recv: previous frame still pending")
+DLOG_ID(HID_LISTEN, "xvc: listening on port %u")
+DLOG_ID(HID_SELECT, "xvc: select, maxfd %d, %d ready")
+DLOG_ID(HID_SELECT_ERR, "xvc: select failed %d")
+DLOG_ID(HID_ACCEPT, "xvc: connection accepted - fd %d")
+DLOG_ID(HID_ACCEPT_ERR, "xvc: accept failed %d")
+DLOG_ID(HID_NODELAY_ERR, "xvc: TCP_NODELAY failed on fd %d")
+DLOG_ID(HID_CLOSE, "xvc: closing fd %d")
+DLOG_ID(HID_EXCEPT, "xvc: exception on fd %d")
+DLOG_ID(XVC_BAD_CMD, "xvc: invalid cmd '%x %x'")
+DLOG_ID(XVC_BAD_LEN, "xvc: shift of %d bits exceeds the buffer")
+DLOG_ID(XVC_SHIFT, "xvc: shift %d bits in %u us")
+DLOG_ID(REC_START, "rec: recording")
+DLOG_ID(REC_STOP, "rec: stopped, %u records, %u bytes")
+DLOG_ID(REC_FULL, "rec: store full after %u records, recording dropped")
+DLOG_ID(REC_REPLAY, "rec: replayed %u records, %u tdo mismatches")
+DLOG_ID(HID_BUSY, "xvc: no free connection, fd %d closed")
+DLOG_ID(PIO_TIMEOUT, "pio: %u bit shift stalled, state machines reset")
+DLOG_ID(XVC_SHIFT_ERR, "xvc: shift of %d bits failed (%d), closing")
+DLOG_ID(XVC_BAD_Z, "xvc: bad shiftz: of %d bits, %d payload bytes, closing")
+DLOG_ID(REC_FLASH_ERR, "rec: flash op at %u failed (%d), recording dropped")
+DLOG_ID(REC_NO_STATE, "rec: TAP state unknown, reset the chain before recording")
+DLOG_ID(REC_REPLAY_ERR, "rec: shift failed at record %u, replay stopped")
+DLOG_ID(XVC_SEND_ERR, "xvc: reply of %d bytes cut at %d, closing")
+DLOG_ID(HID_SNDTIMEO_ERR, "xvc: SO_SNDTIMEO failed on fd %d")
+DLOG_ID(HID_TX_RESET, "xvc: replies on fd %d not acknowledged, resetting")
+DLOG_ID(DISPATCH_CALIB_ERR, "dispatch: path %u failed a %d bit shift, not calibrated")
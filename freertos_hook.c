@@ -29,6 +29,12 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "common/tusb_common.h"
+#include "hardware/timer.h"
+
+uint32_t xvc_run_time_us(void)
+{
+  return time_us_32();
+}
 
 
 void vApplicationMallocFailedHook(void)
@@ -0,0 +1,243 @@
+#include "backends.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xfer_chain.h"
+
+// Runs xfer_chain control-block lists the way the DMA and the two tdata
+// state machines would: each stream is walked block by block up to its null
+// block and fed to a model of the tdata program, tdi loops back to tdo with
+// the bits above nbits zeroed. A block aimed at the wrong fifo, with the
+// wrong ctrl word or streams that disagree abort.
+
+#define SIM_WORDS (XFER_CHAIN_MAX * (XVC_VECTOR_WORDS + 1))
+
+static uint32_t tms_txf, tdi_txf, tdo_rxf; // only their addresses matter
+static const xfer_chain_hw_t sim_hw = {&tms_txf, &tdi_txf, &tdo_rxf, 0x101, 0x202, 0x303};
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "chain sim: %s\n", what);
+    abort();
+}
+
+// the words a tx stream pushes into its fifo, returns their number
+static int tx_stream(const xfer_cb_t *cb, volatile void *fifo, uint32_t ctrl, uint32_t *out)
+{
+    int n = 0;
+    for (; cb->ctrl; cb++)
+    {
+        if (cb->write != fifo || cb->ctrl != ctrl)
+            fail("tx block for another fifo");
+        if (n + cb->count > SIM_WORDS)
+            fail("tx stream overruns");
+        memcpy(out + n, (const void *)cb->read, cb->count * 4);
+        n += cb->count;
+    }
+    if (cb->read || cb->write || cb->count)
+        fail("stream not ended by a null block");
+    return n;
+}
+
+// tdata.pio instruction by instruction, keep in step with the program.
+// Pins loop tdi back to tdo, the OSR autopulls and the ISR autopushes at 32
+// bits, shifting right
+enum { OUT_PINS, IN_PINS, NOP, JMP_Y_DEC, JMP_X_DEC, JMP, PULL, OUT_Y16, OUT_X16, OUT_NULL, IN_NULL };
+typedef struct
+{
+    int op, target;
+} sim_insn_t;
+
+#define SIM_HEADER 7
+#define SIM_WRAP 9 // .wrap, back to countloop
+static const sim_insn_t tdata[] = {
+    {OUT_PINS, 0}, {IN_PINS, 0}, {NOP, 0}, {NOP, 0}, {NOP, 0}, {JMP_Y_DEC, 0}, {JMP_X_DEC, 10},
+    {PULL, 0}, {OUT_Y16, 0}, {OUT_X16, 0},
+    {OUT_NULL, 0}, {IN_NULL, 0}, {JMP_X_DEC, 10}, {JMP, SIM_HEADER},
+};
+
+// runs one state machine from the header pull until it stalls there with its
+// tx stream drained; returns the rx words, the period words it loaded go to
+// periods
+static int run_sm(const uint32_t *tx, int ntx, uint32_t *rx, uint32_t *periods, int *nperiods)
+{
+    uint32_t osr = 0, isr = 0, x = 0, y = 0, pin = 0;
+    int osr_count = 32, isr_count = 0, t = 0, n = 0, pc = SIM_HEADER;
+    *nperiods = 0;
+    for (long steps = 0;; steps++)
+    {
+        const sim_insn_t *i = &tdata[pc];
+        int next = pc == SIM_WRAP ? 0 : pc + 1;
+        if (steps > 64L * 32 * SIM_WORDS)
+            fail("state machine never stalls");
+        // autopull, in the background of whatever runs next
+        if (osr_count == 32 && t < ntx)
+        {
+            osr = tx[t++];
+            osr_count = 0;
+        }
+        switch (i->op)
+        {
+        case OUT_PINS:
+        case OUT_NULL:
+            if (osr_count == 32)
+                fail("out stalls inside a shift");
+            if (i->op == OUT_PINS)
+                pin = osr & 1;
+            osr >>= 1;
+            osr_count++;
+            break;
+        case IN_PINS:
+        case IN_NULL:
+            isr = isr >> 1 | (i->op == IN_PINS ? pin : 0) << 31;
+            if (++isr_count == 32)
+            {
+                if (n == SIM_WORDS)
+                    fail("rx overruns");
+                rx[n++] = isr;
+                isr_count = 0;
+            }
+            break;
+        case NOP:
+            break;
+        case JMP_Y_DEC:
+            if (y-- != 0)
+                next = i->target;
+            break;
+        case JMP_X_DEC:
+            if (x-- != 0)
+                next = i->target;
+            break;
+        case JMP:
+            next = i->target;
+            break;
+        case PULL:
+            // a full OSR makes pull a no-op under autopull
+            if (osr_count == 0)
+                break;
+            if (t == ntx)
+            {
+                if (isr_count)
+                    fail("stalls with rx bits not pushed");
+                return n;
+            }
+            osr = tx[t++];
+            osr_count = 0;
+            break;
+        case OUT_Y16:
+        case OUT_X16:
+            if (osr_count > 16)
+                fail("out y/x past the period word");
+            if (i->op == OUT_Y16)
+                y = osr & 0xffff;
+            else
+                x = osr & 0xffff;
+            osr >>= 16;
+            osr_count += 16;
+            if (i->op == OUT_X16 && *nperiods < SIM_WORDS)
+                periods[(*nperiods)++] = x << 16 | y;
+            break;
+        }
+        pc = next;
+    }
+}
+
+// the tdi state machine feeds tdo, the tms one has to load the same periods
+static int run_pair(const uint32_t *tms, int ntms, const uint32_t *tdi, int ntdi, uint32_t *rx)
+{
+    static uint32_t tms_rx[SIM_WORDS], tms_periods[SIM_WORDS], tdi_periods[SIM_WORDS];
+    int ntp, ndp;
+    int n = run_sm(tdi, ntdi, rx, tdi_periods, &ndp);
+    int ntms_rx = run_sm(tms, ntms, tms_rx, tms_periods, &ntp);
+    if (ntp != ndp || memcmp(tms_periods, tdi_periods, ndp * 4) || ntms_rx != n)
+        fail("tms and tdi streams disagree on a period");
+    for (int p = 0; p < ndp; p++)
+    {
+        int nbits = (tdi_periods[p] & 0xffff) + 1;
+        if ((int)(tdi_periods[p] >> 16) != (nbits % 32 ? 32 - nbits % 32 : 0))
+            fail("bad pad in a period word");
+    }
+    return n;
+}
+
+static void sim_run(const xfer_chain_t *c)
+{
+    static uint32_t tms[SIM_WORDS], tdi[SIM_WORDS], rx[SIM_WORDS];
+    int ntms = tx_stream(c->tms, sim_hw.tms_fifo, sim_hw.tms_ctrl, tms);
+    int ntdi = tx_stream(c->tdi, sim_hw.tdi_fifo, sim_hw.tdi_ctrl, tdi);
+    int nrx = run_pair(tms, ntms, tdi, ntdi, rx), got = 0;
+    if ((uint32_t)nrx != c->words)
+        fail("sink count differs from the tdo words");
+    const xfer_cb_t *cb = c->tdo;
+    for (; cb->ctrl; cb++)
+    {
+        if (cb->read != sim_hw.tdo_fifo || cb->ctrl != sim_hw.tdo_ctrl)
+            fail("tdo block for another fifo");
+        if (got + (int)cb->count > nrx)
+            fail("tdo stream reads more than was pushed");
+        memcpy((void *)cb->write, rx + got, cb->count * 4);
+        got += cb->count;
+    }
+    if (got != nrx)
+        fail("tdo stream leaves words in the fifo");
+}
+
+static int chain_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    static xfer_chain_t c;
+    (void)ctx;
+    xfer_chain_init(&c, &sim_hw);
+    if (xfer_chain_add(&c, tms, tdi, tdo, nbits) < 0)
+        return -1;
+    sim_run(&c);
+    return 0;
+}
+
+const xvc_backend_t chain_backend = {
+    .ctx = 0,
+    .shift = chain_shift,
+    .set_tck = 0,
+};
+
+int chain_batch_check(long count)
+{
+    static xfer_chain_t c;
+    static uint32_t tms[XFER_CHAIN_MAX][8], tdi[XFER_CHAIN_MAX][8], tdo[XFER_CHAIN_MAX][8];
+    int nbits[XFER_CHAIN_MAX];
+    long bad = 0;
+
+    for (long done = 0; done < count;)
+    {
+        int k = 1 + rand() % XFER_CHAIN_MAX;
+        xfer_chain_init(&c, &sim_hw);
+        for (int i = 0; i < k; i++)
+        {
+            for (int w = 0; w < 8; w++)
+            {
+                tms[i][w] = rand();
+                tdi[i][w] = rand();
+                tdo[i][w] = 0xdeadbeef;
+            }
+            nbits[i] = 1 + rand() % 256;
+            if (xfer_chain_add(&c, tms[i], tdi[i], tdo[i], nbits[i]) < 0)
+                fail("add refused below XFER_CHAIN_MAX");
+        }
+        if (k == XFER_CHAIN_MAX && xfer_chain_add(&c, tms[0], tdi[0], tdo[0], 1) == 0)
+            fail("add accepted beyond XFER_CHAIN_MAX");
+        sim_run(&c);
+        for (int i = 0; i < k; i++)
+        {
+            int words = (nbits[i] + 31) / 32;
+            for (int w = 0; w < 8; w++)
+            {
+                uint32_t want = tdi[i][w];
+                if (w == words - 1 && nbits[i] % 32)
+                    want &= (1u << (nbits[i] % 32)) - 1;
+                bad += w < words ? tdo[i][w] != want : tdo[i][w] != 0xdeadbeef;
+            }
+        }
+        done += k;
+    }
+    return bad ? -1 : 0;
+}
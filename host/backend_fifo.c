@@ -0,0 +1,250 @@
+#include "backends.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xfer_queue.h"
+#include "xvc_stats.h"
+
+// Fake of the two tdata state machines behind xfer_queue: 4 word tx and rx
+// fifos, tdi looped back to tdo with the tail zeroed like the loopblock path,
+// and a shifter that moves a random number of words per look at the fifos so
+// the engine sees every fill level. Engine misuse aborts. fifo_stall_every()
+// makes the shifter freeze on some requests until the engine resets it.
+typedef struct fake_pio
+{
+    uint32_t tx[4], rx[4];
+    int ntx, nrx;
+    int words_left, tail_bits; // of the running request
+    int outstanding;           // pushed and not pulled yet
+    int window;
+    long stall_every, starts;
+    bool stalled;
+    bool in_irq; // inside the stand-in for the interrupt handler
+} fake_pio_t;
+
+static fake_pio_t fake;
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "fake pio: %s\n", what);
+    abort();
+}
+
+static void run(fake_pio_t *f)
+{
+    for (int n = f->stalled ? 0 : rand() % 3; n && f->ntx && f->nrx < 4; n--)
+    {
+        uint32_t w = f->tx[0];
+        memmove(f->tx, f->tx + 1, --f->ntx * 4);
+        if (--f->words_left == 0 && f->tail_bits)
+            w &= (1u << f->tail_bits) - 1;
+        f->rx[f->nrx++] = w;
+    }
+}
+
+static void fake_start(void *ctx, int nbits)
+{
+    fake_pio_t *f = ctx;
+    if (f->words_left || f->ntx || f->nrx)
+        fail("start while a request is running");
+    if (f->in_irq)
+        fail("start from the interrupt handler");
+    f->words_left = (nbits + 31) / 32;
+    f->tail_bits = nbits % 32;
+    f->stalled = f->stall_every && ++f->starts % f->stall_every == 0;
+}
+
+static bool fake_tx_full(void *ctx)
+{
+    fake_pio_t *f = ctx;
+    run(f);
+    return f->ntx == 4;
+}
+
+static void fake_put(void *ctx, uint32_t tms, uint32_t tdi)
+{
+    fake_pio_t *f = ctx;
+    (void)tms;
+    if (f->ntx == 4)
+        fail("put on a full fifo");
+    if (++f->outstanding > f->window)
+        fail("more words in flight than the window");
+    f->tx[f->ntx++] = tdi;
+}
+
+static bool fake_rx_empty(void *ctx)
+{
+    fake_pio_t *f = ctx;
+    run(f);
+    return f->nrx == 0;
+}
+
+static uint32_t fake_get(void *ctx)
+{
+    fake_pio_t *f = ctx;
+    if (!f->nrx)
+        fail("get on an empty fifo");
+    uint32_t w = f->rx[0];
+    memmove(f->rx, f->rx + 1, --f->nrx * 4);
+    f->outstanding--;
+    return w;
+}
+
+static void fake_reset(void *ctx, int nbits)
+{
+    fake_pio_t *f = ctx;
+    (void)nbits;
+    f->ntx = f->nrx = 0;
+    f->words_left = f->outstanding = 0;
+    f->stalled = false;
+    xvc_counters.shift_timeouts++;
+}
+
+static const xfer_port_t fake_port = {&fake, 4, fake_start, fake_tx_full, fake_put, fake_rx_empty, fake_get, fake_reset};
+static xfer_queue_t queue;
+
+#define FIFO_TIMEOUT_US 1000
+
+void fifo_stall_every(long n)
+{
+    fake.stall_every = n;
+    fake.starts = 0;
+}
+
+static int fifo_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    (void)ctx;
+    xfer_req_t req = {.tms = tms, .tdi = tdi, .tdo = tdo, .nbits = nbits, .timeout_us = FIFO_TIMEOUT_US};
+    if (!queue.port)
+    {
+        fake.window = fake_port.window;
+        xfer_queue_init(&queue, &fake_port);
+    }
+    while (xfer_queue_submit(&queue, &req) < 0)
+        xfer_queue_service(&queue);
+    return xfer_queue_wait(&queue, &req);
+}
+
+const xvc_backend_t fifo_backend = {
+    .ctx = 0,
+    .shift = fifo_shift,
+    .set_tck = 0,
+};
+
+// completion order and data check with XFER_QUEUE_DEPTH requests in flight
+static uint32_t next_done;
+
+static void check_done(xfer_req_t *req)
+{
+    if ((uint32_t)(uintptr_t)req->arg != next_done++)
+        fail("requests completed out of order");
+}
+
+int fifo_pipeline_check(long count)
+{
+    static uint32_t tms[XFER_QUEUE_DEPTH][8], tdi[XFER_QUEUE_DEPTH][8], tdo[XFER_QUEUE_DEPTH][8];
+    xfer_req_t reqs[XFER_QUEUE_DEPTH];
+    uint32_t submitted = 0;
+    long bad = 0;
+
+    fake.window = fake_port.window;
+    xfer_queue_init(&queue, &fake_port);
+    next_done = 0;
+    memset(reqs, 0, sizeof(reqs));
+    while (next_done < count)
+    {
+        // refill every slot whose request is done, in ring order
+        xfer_req_t *r = &reqs[submitted % XFER_QUEUE_DEPTH];
+        if (submitted < count && (submitted < XFER_QUEUE_DEPTH || r->status != XFER_PENDING))
+        {
+            int slot = submitted % XFER_QUEUE_DEPTH;
+            if (submitted >= XFER_QUEUE_DEPTH)
+            {
+                // check the previous occupant
+                int words = (r->nbits + 31) / 32;
+                for (int w = 0; w < words; w++)
+                {
+                    uint32_t want = tdi[slot][w];
+                    if (w == words - 1 && r->nbits % 32)
+                        want &= (1u << (r->nbits % 32)) - 1;
+                    bad += tdo[slot][w] != want;
+                }
+            }
+            for (int w = 0; w < 8; w++)
+            {
+                tms[slot][w] = rand();
+                tdi[slot][w] = rand();
+            }
+            *r = (xfer_req_t){.tms = tms[slot], .tdi = tdi[slot], .tdo = tdo[slot], .nbits = 1 + rand() % 256,
+                              .done = check_done, .arg = (void *)(uintptr_t)submitted};
+            if (xfer_queue_submit(&queue, r) < 0)
+                fail("submit refused below the depth");
+            submitted++;
+            continue;
+        }
+        xfer_queue_service(&queue);
+    }
+    return bad ? -1 : 0;
+}
+
+// service only when an event armed through xfer_queue_wants() is pending,
+// like the pio interrupt handler, and start requests outside of it like
+// rw_irq(); two requests are queued so the handler hands one back unstarted.
+// A request that stops raising events hangs
+int fifo_irq_check(long count)
+{
+    static uint32_t tms[2][8], tdi[2][8], tdo[2][8];
+    long bad = 0;
+
+    fake.window = fake_port.window;
+    xfer_queue_init(&queue, &fake_port);
+    for (long i = 0; i < count; i += 2)
+    {
+        xfer_req_t reqs[2];
+        for (int r = 0; r < 2; r++)
+        {
+            reqs[r] = (xfer_req_t){.tms = tms[r], .tdi = tdi[r], .tdo = tdo[r], .nbits = 1 + rand() % 256};
+            for (int w = 0; w < 8; w++)
+                tdi[r][w] = rand();
+            xfer_queue_submit(&queue, &reqs[r]);
+        }
+        for (int idle = 0; reqs[1].status == XFER_PENDING; idle++)
+        {
+            int want = xfer_queue_wants(&queue);
+            run(&fake);
+            if (want & XFER_WANT_START)
+            {
+                if (want != XFER_WANT_START)
+                    fail("events armed for a request that is not started");
+                xfer_queue_service(&queue);
+                idle = 0;
+            }
+            else if (((want & XFER_WANT_RX) && fake.nrx) || ((want & XFER_WANT_TX) && fake.ntx < 4))
+            {
+                fake.in_irq = true;
+                xfer_queue_service_started(&queue);
+                fake.in_irq = false;
+                idle = 0;
+            }
+            else if (idle == 1000)
+            {
+                fail("no armed event while a request is pending");
+            }
+        }
+        for (int r = 0; r < 2; r++)
+        {
+            int words = (reqs[r].nbits + 31) / 32;
+            for (int w = 0; w < words; w++)
+            {
+                uint32_t want = tdi[r][w];
+                if (w == words - 1 && reqs[r].nbits % 32)
+                    want &= (1u << (reqs[r].nbits % 32)) - 1;
+                bad += tdo[r][w] != want;
+            }
+        }
+        if (xfer_queue_wants(&queue))
+            fail("events armed with nothing queued");
+    }
+    return bad ? -1 : 0;
+}
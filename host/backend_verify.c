@@ -0,0 +1,43 @@
+#include "backends.h"
+#include <stdio.h>
+
+#include "bitvec.h"
+
+// Runs every shift through the backend under test and through a reference
+// backend fed the same vectors, then compares TDO bit for bit.
+static int verify_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    verify_backend_t *v = ctx;
+    static uint32_t ref[XVC_VECTOR_WORDS + 1];
+    int r = v->test->shift(v->test->ctx, tms, tdi, tdo, nbits);
+    v->ref->shift(v->ref->ctx, tms, tdi, ref, nbits);
+    v->shifts++;
+    for (int i = 0; i < nbits; i++)
+    {
+        if (bitvec_get(tdo, i) != bitvec_get(ref, i))
+        {
+            if (!v->mismatches++)
+                fprintf(stderr, "verify: shift %llu bit %d of %d differs\n", (unsigned long long)v->shifts, i, nbits);
+            return -1;
+        }
+    }
+    return r;
+}
+
+static uint32_t verify_set_tck(void *ctx, uint32_t period_ns)
+{
+    verify_backend_t *v = ctx;
+    return v->test->set_tck ? v->test->set_tck(v->test->ctx, period_ns) : period_ns;
+}
+
+void verify_backend_init(verify_backend_t *v, const xvc_backend_t *test, const xvc_backend_t *ref)
+{
+    v->test = test;
+    v->ref = ref;
+    v->shifts = 0;
+    v->mismatches = 0;
+    v->backend.ctx = v;
+    v->backend.shift = verify_shift;
+    v->backend.set_tck = verify_set_tck;
+    v->backend.idle = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef __BACKENDS_H__
+#define __BACKENDS_H__
+
+#include "xvc_backend.h"
+#include "xvc_server.h"
+
+// host shift backends for xvc_server_host
+extern const xvc_backend_t loopback_backend;
+// loopback through the xfer_queue engine and a fake of the pio fifos
+extern const xvc_backend_t fifo_backend;
+// runs count random requests with the queue kept full, checks completion
+// order and tdo, returns -1 on a tdo mismatch (order errors abort)
+int fifo_pipeline_check(long count);
+// count requests serviced only on the fifo events xfer_queue_wants() arms,
+// as the firmware interrupt handler does, returns -1 on a tdo mismatch
+int fifo_irq_check(long count);
+// every n-th request on the fifo fake stalls until it times out, 0 never
+void fifo_stall_every(long n);
+
+// loopback through xfer_chain control-block lists and a model of the DMA
+// and the state machines; every shift is a chain of one
+extern const xvc_backend_t chain_backend;
+// runs count random shifts in chains of up to XFER_CHAIN_MAX, returns -1 on
+// a tdo mismatch (malformed lists abort)
+int chain_batch_check(long count);
+
+// checks jtag_ops.c on vtap chains: the path table, IDCODE and a user register
+// scan, and count random ops fused against flushed one by one; -1 on mismatch
+int jtag_ops_check(long count);
+
+// checks xvc_chksum.c against a reference sum on count random buffers and
+// count / 10 frames, -1 on mismatch
+int chksum_check(long count);
+
+// feeds xvc_server.c shift headers with negative, 0, oversized and INT_MAX
+// range lengths, -1 when one is not refused before the backend
+int server_check(void);
+
+// checks the shift caches of tap_track.c and tdi_rle.c with count repeated
+// shifts against a plain vtap chain and times them, -1 on mismatch
+int shift_cache_check(long count);
+
+// compares every TDO vector of test against ref, see backend_verify.c
+typedef struct verify_backend
+{
+    xvc_backend_t backend;
+    const xvc_backend_t *test, *ref;
+    uint64_t shifts, mismatches;
+} verify_backend_t;
+
+void verify_backend_init(verify_backend_t *v, const xvc_backend_t *test, const xvc_backend_t *ref);
+
+#endif
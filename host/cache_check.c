@@ -0,0 +1,215 @@
+#include "backends.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shift_cache.h"
+#include "tap_track.h"
+#include "tdi_rle.h"
+#include "vtap.h"
+
+// shift_cache.c in tap_track.c and tdi_rle.c: a pool of shifts like the ones
+// Vivado repeats (status polls with idle clocks, IDCODE reads, constant TDI
+// fills) is replayed in a skewed random order, with more distinct shifts than
+// slots and garbage above nbits as in the server's buffers. Short TMS walks
+// leave the TAP anywhere before shifts of TMS=0, which idle in one state and
+// shift data in another. Every TDO of tap_track over tdi_rle over a vtap
+// chain is compared with a plain vtap chain, then the same sequence is timed
+// through both layers on a backend that clocks nothing, with and without the
+// caches.
+
+#define POOL 12
+#define WALKS 4 // the last ones of the pool, walks and TMS=0 shifts
+#define POOL_WORDS 64 // 2048 bits
+
+typedef struct vec
+{
+    int nbits;
+    uint32_t tms[POOL_WORDS], tdi[POOL_WORDS];
+} vec_t;
+
+static vec_t pool[POOL];
+static uint32_t tms[POOL_WORDS], tdi[POOL_WORDS], tdo[POOL_WORDS + 1];
+static vtap_chain_t chain, ref_chain;
+static xvc_backend_t chain_back, ref_back;
+static tap_track_t track;
+static tdi_rle_t rle;
+static verify_backend_t verify;
+
+static void put(vec_t *v, int tms, int tdi, int count)
+{
+    for (; count > 0 && v->nbits < POOL_WORDS * 32; count--, v->nbits++)
+    {
+        uint32_t bit = 1u << (v->nbits & 31);
+        v->tms[v->nbits >> 5] |= tms ? bit : 0;
+        v->tdi[v->nbits >> 5] |= tdi ? bit : 0;
+    }
+}
+
+// [reset], idle in Run-Test/Idle, one DR scan, back to Run-Test/Idle and idle again
+static void make(vec_t *v, int reset, int fill)
+{
+    memset(v, 0, sizeof(*v));
+    if (reset)
+        put(v, 1, 0, 5);
+    put(v, 0, 0, 1 + rand() % 300);
+    put(v, 1, 0, 1);
+    put(v, 0, 0, 2);
+    int n = 32 + rand() % 600;
+    for (int i = 0; i < n - 1; i++)
+        put(v, 0, fill < 0 ? rand() & 1 : fill, 1);
+    put(v, 1, rand() & 1, 1);
+    put(v, 1, 0, 1);
+    put(v, 0, 0, 1 + rand() % 200);
+}
+
+static void make_pool(void)
+{
+    for (int i = 0; i < POOL - WALKS; i++)
+        make(&pool[i], i % 3 == 0, i % 2 ? -1 : i % 4 == 0);
+    for (int i = POOL - WALKS; i < POOL; i++)
+    {
+        // walks are too short for the cache, the TMS=0 shifts go in from any state
+        memset(&pool[i], 0, sizeof(pool[i]));
+        int walk = i % 2, n = walk ? 2 + rand() % 20 : 70 + rand() % 100;
+        for (int b = 0; b < n; b++)
+            put(&pool[i], walk && rand() % 3 == 0, rand() & 1, 1);
+    }
+}
+
+// a few shifts most of the time, the walks often, every one now and then
+static int pick(void)
+{
+    int r = rand() % 8;
+    return r < 4 ? rand() % 4 : r < 6 ? POOL - WALKS + rand() % WALKS : rand() % POOL;
+}
+
+static int null_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    (void)ctx;
+    (void)tms;
+    (void)tdi;
+    memset(tdo, 0, (nbits + 31) / 32 * 4);
+    return 0;
+}
+
+static int null_idle(void *ctx, int tms, uint32_t count)
+{
+    (void)ctx;
+    (void)tms;
+    (void)count;
+    return 0;
+}
+
+static int null_repeat(void *ctx, int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    (void)tms;
+    (void)tdi;
+    return null_shift(ctx, NULL, NULL, tdo, count);
+}
+
+static const xvc_backend_t null_backend = {
+    .ctx = 0,
+    .shift = null_shift,
+    .set_tck = 0,
+    .idle = null_idle,
+    .repeat = null_repeat,
+};
+
+// least recently used order, a slot for every shift, and a key that matches
+// a slot of other vectors (a hash collision, made by editing the slot) misses
+static int check_lru(void)
+{
+    static shift_cache_t c;
+    uint32_t v[3] = {0};
+    int slot, bad = 0;
+#define GET(k, n) (v[0] = (k), shift_cache_get(&c, v, NULL, (n), 0, &slot))
+    shift_cache_init(&c);
+    for (int k = 1; k <= SHIFT_CACHE_SLOTS; k++)
+        bad += GET(k, 64);
+    bad += !GET(1, 64);
+    bad += GET(1, 65); // same vectors, other length
+    bad += GET(100, 64);
+    bad += !GET(1, 64) || GET(2, 64) || GET(3, 64);
+    bad += shift_cache_get(&c, v, NULL, 64, 1, &slot); // other salt
+    if (bad)
+        fprintf(stderr, "shift_cache: bad lru order\n");
+
+    GET(1, 64);
+    c.tms[slot][1] ^= 1;
+    uint32_t collisions = c.collisions;
+    int was = slot;
+    if (GET(1, 64) || slot != was || c.collisions != collisions + 1 || !GET(1, 64))
+    {
+        fprintf(stderr, "shift_cache: a colliding key hit\n");
+        bad++;
+    }
+#undef GET
+    return bad;
+}
+
+static double run(const xvc_backend_t *b, long count)
+{
+    struct timespec t0, t1;
+    srand(7);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < count; i++)
+    {
+        const vec_t *v = &pool[pick()];
+        int words = (v->nbits + 31) / 32;
+        memcpy(tms, v->tms, words * 4);
+        memcpy(tdi, v->tdi, words * 4);
+        if (v->nbits % 32)
+        {
+            tms[words - 1] |= (uint32_t)rand() << (v->nbits % 32);
+            tdi[words - 1] |= (uint32_t)rand() << (v->nbits % 32);
+        }
+        b->shift(b->ctx, tms, tdi, tdo, v->nbits);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / count;
+}
+
+static void print(const char *layer, const shift_cache_t *c)
+{
+    char text[1024];
+    shift_cache_report(c, layer, text, sizeof(text));
+    printf("%s", text);
+}
+
+int shift_cache_check(long count)
+{
+    long bad = check_lru();
+
+    srand(5);
+    make_pool();
+    vtap_init(&chain);
+    vtap_add_user(vtap_add(&chain, 6, 0x0362d093, 0x09), 0x02, 32, 0);
+    ref_chain = chain;
+    chain_back = vtap_backend_ops;
+    chain_back.ctx = &chain;
+    ref_back = vtap_backend_ops;
+    ref_back.ctx = &ref_chain;
+    tdi_rle_init(&rle, &chain_back);
+    tap_track_init(&track, &rle.backend);
+    verify_backend_init(&verify, &track.backend, &ref_back);
+    run(&verify.backend, count);
+    bad += verify.mismatches;
+    // the hot shifts alone are half of them
+    bad += track.cache.hits * 2 < track.cache.hits + track.cache.misses;
+    bad += rle.cache.hits * 2 < rle.cache.hits + rle.cache.misses;
+    printf("shift_cache: %ld shifts on vtap, %llu tdo mismatches\n", count, (unsigned long long)verify.mismatches);
+    print("tap_track", &track.cache);
+    print("tdi_rle", &rle.cache);
+
+    tdi_rle_init(&rle, &null_backend);
+    tap_track_init(&track, &rle.backend);
+    double cached = run(&track.backend, count);
+    tdi_rle_init(&rle, &null_backend);
+    tap_track_init(&track, &rle.backend);
+    track.cached = rle.cached = false;
+    double plain = run(&track.backend, count);
+    printf("shift_cache: tap_track + tdi_rle %.0f ns per shift cached, %.0f ns uncached\n", cached, plain);
+    return bad ? -1 : 0;
+}
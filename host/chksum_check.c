@@ -0,0 +1,113 @@
+#include "backends.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xvc_chksum.h"
+
+// xvc_chksum.c against a byte at a time RFC 1071 sum: every alignment of
+// source and destination, random lengths, and whole frames through
+// xvc_frame_copy() with good, corrupted, fragmented and non-TCP contents.
+
+#define MAX_LEN 1600
+
+static uint8_t src[MAX_LEN + 8], dst[MAX_LEN + 8], frame[MAX_LEN];
+
+// little endian 16 bit words from the first byte, folded, not inverted
+static uint16_t ref_chksum(const uint8_t *b, int len)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < len; i++)
+        sum += (uint32_t)b[i] << (i & 1 ? 8 : 0);
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+static int check_sums(long count)
+{
+    int bad = 0;
+    for (long i = 0; i < count; i++)
+    {
+        int so = rand() % 8, dof = rand() % 8, len = rand() % 4 ? rand() % 200 : rand() % MAX_LEN;
+        for (int k = 0; k < len; k++)
+            src[so + k] = rand() % 8 ? rand() : 0xff; // runs of ones exercise the carries
+        memset(dst, 0xa5, sizeof(dst));
+        uint16_t ref = ref_chksum(src + so, len);
+        bad += xvc_chksum(src + so, len) != ref;
+        bad += xvc_chksum_copy(dst + dof, src + so, len) != ref;
+        bad += memcmp(dst + dof, src + so, len) != 0 || dst[dof + len] != 0xa5 || (dof && dst[dof - 1] != 0xa5);
+    }
+    return bad;
+}
+
+// ethernet + IPv4 + TCP with a correct checksum, returns the frame length
+static int make_frame(int payload, int pad)
+{
+    int seg = 20 + payload, total = 20 + seg;
+    memset(frame, 0, 14 + total + pad);
+    frame[12] = 0x08;
+    frame[14] = 0x45;
+    frame[16] = total >> 8;
+    frame[17] = total & 0xff;
+    frame[22] = 64;
+    frame[23] = 6;
+    for (int k = 26; k < 34; k++)
+        frame[k] = rand();
+    for (int k = 34; k < 14 + total; k++)
+        frame[k] = rand();
+    frame[50] = frame[51] = 0;
+    // pseudo header then segment, big endian sum for the wire field
+    static uint8_t ph[12 + MAX_LEN];
+    memcpy(ph, frame + 26, 8);
+    ph[8] = 0;
+    ph[9] = 6;
+    ph[10] = seg >> 8;
+    ph[11] = seg & 0xff;
+    memcpy(ph + 12, frame + 34, seg);
+    uint16_t sum = ~ref_chksum(ph, 12 + seg);
+    memcpy(frame + 50, &sum, 2);
+    for (int k = 0; k < pad; k++)
+        frame[14 + total + k] = rand();
+    return 14 + total + pad;
+}
+
+static int check_frames(long count)
+{
+    int bad = 0;
+    for (long i = 0; i < count; i++)
+    {
+        int dof = rand() % 4, len = make_frame(rand() % 1400, rand() % 3 ? 0 : rand() % 20);
+        int r = xvc_frame_copy(dst + dof, frame, len);
+        bad += r != 1 || memcmp(dst + dof, frame, len) != 0;
+        switch (rand() % 4)
+        {
+        case 0: // a flipped bit anywhere in the segment
+            frame[34 + rand() % ((frame[16] << 8 | frame[17]) - 20)] ^= 1 << rand() % 8;
+            bad += xvc_frame_copy(dst + dof, frame, len) != -1;
+            break;
+        case 1: // more fragments
+            frame[20] |= 0x20;
+            bad += xvc_frame_copy(dst + dof, frame, len) != -1;
+            break;
+        case 2: // UDP
+            frame[23] = 17;
+            bad += xvc_frame_copy(dst + dof, frame, len) != 0 || memcmp(dst + dof, frame, len) != 0;
+            break;
+        default: // IPv4 total length beyond the frame
+            frame[16] = 0xff;
+            bad += xvc_frame_copy(dst + dof, frame, len) != -1;
+            break;
+        }
+    }
+    return bad;
+}
+
+int chksum_check(long count)
+{
+    srand(5);
+    int bad = check_sums(count) + check_frames(count / 10 + 1);
+
+    printf("xvc_chksum: %ld buffers and %ld frames, %d mismatches\n", count, count / 10 + 1, bad);
+    return bad ? -1 : 0;
+}
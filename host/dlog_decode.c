@@ -0,0 +1,52 @@
+// Decodes a binary dlog capture (firmware built with XVC_DLOG_BINARY=ON)
+//   dlog_decode < capture.bin
+//   dlog_decode /dev/ttyACM0
+#include <stdio.h>
+#include <string.h>
+
+#include "dlog.h"
+
+static const char *const dlog_fmt[DLOG_ID_COUNT] = {
+#define DLOG_ID(name, fmt) fmt,
+#include "dlog_ids.h"
+#undef DLOG_ID
+};
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    if (argc > 1 && !(in = fopen(argv[1], "rb")))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    int c, prev = -1;
+    unsigned long skipped = 0;
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (prev != DLOG_SYNC0 || c != DLOG_SYNC1)
+        {
+            prev = c;
+            skipped++;
+            continue;
+        }
+        prev = -1;
+        skipped--;
+
+        dlog_rec_t r;
+        if (fread(&r, sizeof(r), 1, in) != 1)
+            break;
+        if (skipped)
+            printf("-- %lu bytes of noise skipped\n", skipped);
+        skipped = 0;
+        printf("[%lu.%06lu %u] ", (unsigned long)(r.ts_us / 1000000), (unsigned long)(r.ts_us % 1000000), r.core);
+        if (r.id < DLOG_ID_COUNT)
+            printf(dlog_fmt[r.id], r.arg[0], r.arg[1]);
+        else
+            printf("unknown id %u %08x %08x", r.id, r.arg[0], r.arg[1]);
+        printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "backends.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jtag_ops.h"
+#include "vtap.h"
+
+// jtag_ops.c against the virtual TAP: the path table, IDCODE and a user
+// register through IR/DR scans, and random op sequences run fused on one
+// chain and flushed after every op on a copy.
+
+#define BATCH 24
+#define MAX_SCAN (JTAG_OPS_BITS + 1000) // longer than one engine run
+#define SCAN_WORDS ((MAX_SCAN + 31) / 32)
+
+static vtap_chain_t chain_a, chain_b;
+static xvc_backend_t back_a, back_b;
+static jtag_ops_t ops_a, ops_b;
+static uint32_t tdi[BATCH][SCAN_WORDS], tdo_a[BATCH][SCAN_WORDS], tdo_b[BATCH][SCAN_WORDS];
+
+static int check_paths(void)
+{
+    int bad = 0;
+    for (int from = 0; from < JTAG_STATE_COUNT; from++)
+    {
+        // breadth first distances from this state
+        int dist[JTAG_STATE_COUNT], queue[JTAG_STATE_COUNT], head = 0, tail = 0;
+        for (int s = 0; s < JTAG_STATE_COUNT; s++)
+            dist[s] = -1;
+        dist[from] = 0;
+        queue[tail++] = from;
+        while (head < tail)
+        {
+            int s = queue[head++];
+            for (int tms = 0; tms < 2; tms++)
+            {
+                int n = jtag_step(s, tms);
+                if (dist[n] < 0)
+                {
+                    dist[n] = dist[s] + 1;
+                    queue[tail++] = n;
+                }
+            }
+        }
+        for (int to = 0; to < JTAG_STATE_COUNT; to++)
+        {
+            jtag_path_t p = jtag_paths[from][to];
+            jtag_state_t s = from;
+            for (int i = 0; i < p.len; i++)
+                s = jtag_step(s, (p.tms >> i) & 1);
+            if ((int)s != to || p.len != dist[to] || p.tms >> p.len)
+            {
+                fprintf(stderr, "jtag_ops: bad path %s -> %s\n", jtag_state_name(from), jtag_state_name(to));
+                bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+static void setup(vtap_chain_t *c, xvc_backend_t *b, jtag_ops_t *o)
+{
+    vtap_init(c);
+    vtap_add_user(vtap_add(c, 6, 0x0362d093, 0x09), 0x02, 32, 0);
+    vtap_add(c, 4, 0x4ba00477, 0x0e);
+    *b = vtap_backend_ops;
+    b->ctx = c;
+    jtag_ops_init(o, b);
+}
+
+// IDCODEs after reset, then USER1 on the first device with the second in
+// BYPASS written and read back, all in one engine run
+static int check_registers(void)
+{
+    uint32_t id[2] = {0}, ir = 0x02 << 4 | 0xf, v[2] = {0x5a5a1234u << 1, 0x5a5a1234u >> 31}, rb[2] = {0};
+    jtag_ops_t *o = &ops_a;
+    setup(&chain_a, &back_a, o);
+    jtag_ops_reset(o);
+    jtag_ops_scan_dr(o, NULL, id, 64, JTAG_RUN_TEST_IDLE);
+    jtag_ops_scan_ir(o, &ir, NULL, 10, JTAG_RUN_TEST_IDLE);
+    jtag_ops_scan_dr(o, v, NULL, 33, JTAG_RUN_TEST_IDLE);
+    jtag_ops_scan_dr(o, NULL, rb, 33, JTAG_PAUSE_DR);
+    if (jtag_ops_flush(o) < 0 || o->runs != 1)
+        return 1;
+    if (id[0] != 0x4ba00477 || id[1] != 0x0362d093)
+    {
+        fprintf(stderr, "jtag_ops: idcodes %08x %08x\n", id[1], id[0]);
+        return 1;
+    }
+    if (rb[0] != v[0] || rb[1] != v[1] || o->state != JTAG_PAUSE_DR || chain_a.state != JTAG_PAUSE_DR)
+    {
+        fprintf(stderr, "jtag_ops: user1 read back %08x %08x\n", rb[1], rb[0]);
+        return 1;
+    }
+    return 0;
+}
+
+static const jtag_state_t ends[] = {
+    JTAG_RUN_TEST_IDLE, JTAG_RUN_TEST_IDLE, JTAG_PAUSE_DR, JTAG_PAUSE_IR,
+    JTAG_SHIFT_DR,      JTAG_SHIFT_IR,      JTAG_TEST_LOGIC_RESET, JTAG_UPDATE_DR,
+};
+
+// one random op on both sides, b flushes right away
+static void random_op(int i)
+{
+    jtag_state_t end = ends[rand() % (sizeof(ends) / sizeof(ends[0]))];
+    int n = rand() % 8 ? 1 + rand() % 300 : 1 + rand() % MAX_SCAN;
+    uint32_t clocks = rand() % 4 ? rand() % 100 : rand() % 20000;
+    const uint32_t *in = rand() % 8 ? tdi[i] : NULL;
+    uint32_t *out_a = rand() % 4 ? tdo_a[i] : NULL, *out_b = out_a ? tdo_b[i] : NULL;
+    for (int w = 0; w < SCAN_WORDS; w++)
+    {
+        tdi[i][w] = rand();
+        tdo_a[i][w] = tdo_b[i][w] = 0xdeadbeef;
+    }
+    switch (rand() % 6)
+    {
+    case 0:
+        jtag_ops_reset(&ops_a);
+        jtag_ops_reset(&ops_b);
+        break;
+    case 1:
+        end = rand() % JTAG_STATE_COUNT;
+        jtag_ops_goto(&ops_a, end);
+        jtag_ops_goto(&ops_b, end);
+        break;
+    case 2:
+        n = 1 + n % 10;
+        jtag_ops_scan_ir(&ops_a, in, out_a, n, end);
+        jtag_ops_scan_ir(&ops_b, in, out_b, n, end);
+        break;
+    case 3:
+    case 4:
+        jtag_ops_scan_dr(&ops_a, in, out_a, n, end);
+        jtag_ops_scan_dr(&ops_b, in, out_b, n, end);
+        break;
+    default:
+        jtag_ops_runtest(&ops_a, clocks, end);
+        jtag_ops_runtest(&ops_b, clocks, end);
+        break;
+    }
+    jtag_ops_flush(&ops_b);
+}
+
+int jtag_ops_check(long count)
+{
+    long bad = check_paths() + check_registers();
+
+    setup(&chain_a, &back_a, &ops_a);
+    setup(&chain_b, &back_b, &ops_b);
+    srand(3);
+    for (long done = 0; done < count;)
+    {
+        int k = 1 + rand() % BATCH;
+        for (int i = 0; i < k; i++)
+            random_op(i);
+        jtag_ops_flush(&ops_a);
+        for (int i = 0; i < k; i++)
+            bad += memcmp(tdo_a[i], tdo_b[i], sizeof(tdo_a[i])) != 0;
+        bad += ops_a.state != chain_a.state || ops_b.state != chain_b.state || chain_a.state != chain_b.state;
+        bad += chain_a.tck != chain_b.tck || memcmp(chain_a.devs, chain_b.devs, sizeof(chain_a.devs)) != 0;
+        done += k;
+    }
+    printf("jtag_ops: %ld ops, %u runs fused, %u flushed per op, %u transitions skipped, %u bits\n", count,
+           (unsigned)ops_a.runs, (unsigned)ops_b.runs, (unsigned)ops_a.skipped, (unsigned)ops_a.bits);
+    return bad ? -1 : 0;
+}
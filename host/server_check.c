@@ -0,0 +1,171 @@
+#include "backends.h"
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+// xvc_server.c against shift lengths off the wire: negative, 0, one past the
+// buffer and the INT_MAX range must close the connection before anything
+// reaches the backend, for shift: and each extension that carries a length.
+// The largest shift that fits and a one bit shift still go through. A
+// transport that lends buffers gets the TDO of shift: in its own buffer and
+// sends it from there, or through write when none is free.
+
+typedef struct mem_transport
+{
+    const uint8_t *in;
+    int len, pos;
+    int written;
+    int lent; // bytes sent from lent_buf
+} mem_transport_t;
+
+enum
+{
+    LEND_NONE,
+    LEND_FREE,
+    LEND_BUSY,
+};
+static int lending;
+static uint32_t lent_buf[XVC_VECTOR_WORDS];
+
+// 0 once the input is used up, so only the server closes the connection
+static int mem_read(void *ctx, void *buf, int len)
+{
+    mem_transport_t *m = ctx;
+    int n = m->len - m->pos < len ? m->len - m->pos : len;
+    memcpy(buf, m->in + m->pos, n);
+    m->pos += n;
+    return n;
+}
+
+static int mem_write(void *ctx, const void *buf, int len)
+{
+    (void)buf;
+    ((mem_transport_t *)ctx)->written += len;
+    return len;
+}
+
+static void *mem_lend(void *ctx, int len)
+{
+    (void)ctx;
+    (void)len;
+    return lending == LEND_FREE ? lent_buf : NULL;
+}
+
+static int mem_send_lent(void *ctx, const void *buf, int len)
+{
+    if (buf != lent_buf)
+        return -1;
+    ((mem_transport_t *)ctx)->lent += len;
+    return len;
+}
+
+static long shifts;
+
+static int count_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    shifts++;
+    return loopback_backend.shift(ctx, tms, tdi, tdo, nbits);
+}
+
+static const xvc_backend_t count_backend = {
+    .ctx = 0,
+    .shift = count_shift,
+    .set_tck = 0,
+    .idle = 0,
+    .repeat = 0,
+};
+
+static xvc_server_t srv;
+static xvc_conn_t conn;
+static uint8_t in[16 + 4 * XVC_BUFFER_SIZE];
+
+// feeds codec: when the command needs it, then the header and payload bytes
+// of payload, returns what xvc_server_feed() returned
+static int feed(const char *name, int32_t len, int payload, mem_transport_t *m)
+{
+    int n = 0, k = strlen(name);
+    if (name[5] == 'z')
+    {
+        memcpy(in, "codec:\x01", 7);
+        n = 7;
+    }
+    memcpy(in + n, name, k);
+    memcpy(in + n + k, &len, 4);
+    n += k + 4;
+    if (name[5] == 'z')
+    {
+        int32_t zlen = 4;
+        memcpy(in + n, &zlen, 4);
+        n += 4;
+    }
+    memset(in + n, 0, payload);
+    *m = (mem_transport_t){in, n + payload, 0, 0, 0};
+    xvc_transport_t t = {
+        .ctx = m, .read = mem_read, .write = mem_write, .lend = lending ? mem_lend : NULL, .send_lent = mem_send_lent};
+    xvc_conn_init(&conn);
+    return xvc_server_feed(&srv, &conn, &t);
+}
+
+int server_check(void)
+{
+    static const char *const names[] = {"shift:", "shiftz:", "shiftv:", "shiftc:"};
+    static const int32_t bad_lens[] = {
+        -1, INT_MIN, 0, XVC_BUFFER_SIZE / 2 * 8 + 1, 0x7ffffff9, 0x7ffffffc, INT_MAX,
+    };
+    int bad = 0;
+    mem_transport_t m;
+
+    xvc_server_init(&srv, &count_backend);
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        for (unsigned j = 0; j < sizeof(bad_lens) / sizeof(bad_lens[0]); j++)
+        {
+            shifts = 0;
+            int r = feed(names[i], bad_lens[j], 0, &m);
+            if (r != 1 || shifts || m.written > (names[i][5] == 'z'))
+            {
+                fprintf(stderr, "xvc_server: %s of %d bits not refused\n", names[i], bad_lens[j]);
+                bad++;
+            }
+        }
+    }
+    // the limits themselves
+    static const int32_t good_lens[] = {1, XVC_BUFFER_SIZE / 2 * 8};
+    for (unsigned j = 0; j < sizeof(good_lens) / sizeof(good_lens[0]); j++)
+    {
+        int nr_bytes = (good_lens[j] + 7) / 8;
+        shifts = 0;
+        int r = feed("shift:", good_lens[j], 2 * nr_bytes, &m);
+        if (r != 0 || shifts != 1 || m.written != nr_bytes)
+        {
+            fprintf(stderr, "xvc_server: shift: of %d bits refused\n", good_lens[j]);
+            bad++;
+        }
+    }
+
+    // tdi comes back on the loopback backend, 0x5a from the payload
+    static const int modes[] = {LEND_FREE, LEND_BUSY};
+    for (unsigned j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+    {
+        int nr_bytes = XVC_BUFFER_SIZE / 2;
+        lending = modes[j];
+        memset(lent_buf, 0, sizeof(lent_buf));
+        int r = feed("shift:", nr_bytes * 8, 0, &m);
+        memset(in + m.len, 0x5a, 2 * nr_bytes);
+        m.len += 2 * nr_bytes;
+        xvc_transport_t t = {
+            .ctx = &m, .read = mem_read, .write = mem_write, .lend = mem_lend, .send_lent = mem_send_lent};
+        r |= xvc_server_feed(&srv, &conn, &t);
+        bool want_lent = lending == LEND_FREE;
+        if (r || m.lent != (want_lent ? nr_bytes : 0) || m.written != (want_lent ? 0 : nr_bytes) ||
+            (want_lent && ((uint8_t *)lent_buf)[nr_bytes - 1] != 0x5a))
+        {
+            fprintf(stderr, "xvc_server: shift: reply %s a lent buffer went wrong\n", want_lent ? "from" : "without");
+            bad++;
+        }
+    }
+    lending = LEND_NONE;
+    printf("xvc_server: %d bad shift lengths refused, limits accepted, lent replies, %d failures\n",
+           (int)(sizeof(names) / sizeof(names[0]) * sizeof(bad_lens) / sizeof(bad_lens[0])), bad);
+    return bad ? -1 : 0;
+}
@@ -0,0 +1,205 @@
+#include "vtap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BYPASS_OP(d) ((d)->ir_len >= 32 ? 0xffffffffu : (1u << (d)->ir_len) - 1)
+
+void vtap_init(vtap_chain_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->tdo_idle = 1;
+    c->state = JTAG_TEST_LOGIC_RESET;
+}
+
+vtap_dev_t *vtap_add(vtap_chain_t *c, int ir_len, uint32_t idcode, uint32_t idcode_op)
+{
+    if (c->count >= VTAP_MAX_DEVS || ir_len < 2 || ir_len > 32)
+        return NULL;
+    vtap_dev_t *d = &c->devs[c->count++];
+    memset(d, 0, sizeof(*d));
+    d->ir_len = ir_len;
+    d->idcode = idcode;
+    d->idcode_op = idcode_op;
+    d->ir = idcode ? idcode_op : BYPASS_OP(d);
+    return d;
+}
+
+void vtap_add_user(vtap_dev_t *d, uint32_t opcode, int len, uint64_t value)
+{
+    if (d->user_count < VTAP_MAX_USER_REGS && len >= 1 && len <= 64)
+        d->user[d->user_count++] = (vtap_user_reg_t){opcode, (uint8_t)len, value};
+}
+
+int vtap_parse(vtap_chain_t *c, const char *spec)
+{
+    while (*spec)
+    {
+        char *end;
+        int ir_len = strtol(spec, &end, 0);
+        uint32_t idcode = 0, op = 1;
+        if (*end == ':')
+            idcode = strtoul(end + 1, &end, 0);
+        if (*end == ':')
+            op = strtoul(end + 1, &end, 0);
+        if (!vtap_add(c, ir_len, idcode, op) || (*end && *end != ','))
+            return -1;
+        spec = *end ? end + 1 : end;
+    }
+    return c->count ? 0 : -1;
+}
+
+void vtap_reset(vtap_chain_t *c)
+{
+    c->state = JTAG_TEST_LOGIC_RESET;
+    for (int i = 0; i < c->count; i++)
+    {
+        vtap_dev_t *d = &c->devs[i];
+        d->ir = d->idcode ? d->idcode_op : BYPASS_OP(d);
+    }
+}
+
+static vtap_user_reg_t *user_reg(vtap_dev_t *d)
+{
+    for (int i = 0; i < d->user_count; i++)
+    {
+        if (d->user[i].opcode == d->ir)
+            return &d->user[i];
+    }
+    return NULL;
+}
+
+static void capture_dr(vtap_dev_t *d)
+{
+    vtap_user_reg_t *u;
+    if (d->idcode && d->ir == d->idcode_op)
+    {
+        d->sr = d->idcode;
+        d->sr_len = 32;
+    }
+    else if ((u = user_reg(d)) != NULL)
+    {
+        d->sr = u->value;
+        d->sr_len = u->len;
+    }
+    else // BYPASS and every unknown instruction
+    {
+        d->sr = 0;
+        d->sr_len = 1;
+    }
+}
+
+static void update_dr(vtap_dev_t *d)
+{
+    vtap_user_reg_t *u = user_reg(d);
+    if (u)
+        u->value = d->sr;
+}
+
+int vtap_clock(vtap_chain_t *c, int tms, int tdi)
+{
+    jtag_state_t s = c->state;
+    int shifting = s == JTAG_SHIFT_DR || s == JTAG_SHIFT_IR;
+    int tdo = shifting && c->count ? (int)(c->devs[c->count - 1].sr & 1) : c->tdo_idle;
+
+    if (c->trace)
+        c->trace(c->trace_ctx, tms, tdi, tdo, s);
+    c->tck++;
+
+    // rising edge: act on the current state, then move
+    for (int i = 0; i < c->count; i++)
+    {
+        vtap_dev_t *d = &c->devs[i];
+        switch (s)
+        {
+        case JTAG_CAPTURE_DR:
+            capture_dr(d);
+            break;
+        case JTAG_CAPTURE_IR:
+            d->sr = 1; // IR capture pattern ...01
+            d->sr_len = d->ir_len;
+            break;
+        case JTAG_SHIFT_DR:
+        case JTAG_SHIFT_IR:
+        {
+            int out = d->sr & 1;
+            d->sr = (d->sr >> 1) | ((uint64_t)(tdi & 1) << (d->sr_len - 1));
+            tdi = out;
+            break;
+        }
+        case JTAG_UPDATE_DR:
+            update_dr(d);
+            break;
+        case JTAG_UPDATE_IR:
+            d->ir = (uint32_t)d->sr;
+            break;
+        default:
+            break;
+        }
+    }
+    c->state = jtag_step(s, tms);
+    if (c->state == JTAG_TEST_LOGIC_RESET && s != JTAG_TEST_LOGIC_RESET)
+        vtap_reset(c);
+    return tdo;
+}
+
+int vtap_shift(vtap_chain_t *c, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    int words = (nbits + 31) / 32;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t m = tms[w], d = tdi[w], o = 0;
+        int n = nbits - w * 32 < 32 ? nbits - w * 32 : 32;
+        for (int i = 0; i < n; i++)
+        {
+            o |= (uint32_t)vtap_clock(c, m & 1, d & 1) << i;
+            m >>= 1;
+            d >>= 1;
+        }
+        tdo[w] = o;
+    }
+    return 0;
+}
+
+// clocks count TCKs with constant TMS, returns the TDO level or -1 if it
+// changed during the run (the caller assumed an undriven TDO)
+int vtap_idle(vtap_chain_t *c, int tms, uint32_t count)
+{
+    int tdo = vtap_clock(c, tms, 0);
+    for (uint32_t i = 1; i < count; i++)
+        if (vtap_clock(c, tms, 0) != tdo)
+            tdo = -1;
+    return tdo;
+}
+
+// clocks count TCKs with constant tms and tdi, tdo is captured LSB first
+int vtap_repeat(vtap_chain_t *c, int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    for (uint32_t w = 0; w < (count + 31) / 32; w++)
+        tdo[w] = 0;
+    for (uint32_t i = 0; i < count; i++)
+        tdo[i / 32] |= (uint32_t)vtap_clock(c, tms, tdi) << (i % 32);
+    return 0;
+}
+
+static int vtap_backend_repeat(void *ctx, int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    return vtap_repeat(ctx, tms, tdi, tdo, count);
+}
+
+static int vtap_backend_idle(void *ctx, int tms, uint32_t count)
+{
+    return vtap_idle(ctx, tms, count);
+}
+
+static int vtap_backend_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    return vtap_shift(ctx, tms, tdi, tdo, nbits);
+}
+
+const xvc_backend_t vtap_backend_ops = {
+    .ctx = 0,
+    .shift = vtap_backend_shift,
+    .set_tck = 0,
+    .idle = vtap_backend_idle,
+    .repeat = vtap_backend_repeat,
+};
@@ -0,0 +1,66 @@
+#ifndef __VTAP_H__
+#define __VTAP_H__
+
+#include <stdint.h>
+
+#include "jtag_tap.h"
+#include "xvc_backend.h"
+
+// Virtual IEEE 1149.1 chain. TDI enters devs[0], TDO leaves devs[count-1].
+// Every device has a TAP controller, IDCODE and BYPASS and a few user data
+// registers selected by their own opcode.
+
+#define VTAP_MAX_DEVS 8
+#define VTAP_MAX_USER_REGS 4
+
+typedef struct vtap_user_reg
+{
+    uint32_t opcode;
+    uint8_t len; // 1..64 bits
+    uint64_t value; // captured in Capture-DR, latched in Update-DR
+} vtap_user_reg_t;
+
+typedef struct vtap_dev
+{
+    uint8_t ir_len;       // 2..32
+    uint32_t idcode;      // 0: no IDCODE register, reset selects BYPASS
+    uint32_t idcode_op;
+    int user_count;
+    vtap_user_reg_t user[VTAP_MAX_USER_REGS];
+
+    // state
+    uint32_t ir;      // current instruction
+    uint64_t sr;      // shift register of the selected IR or DR path
+    uint8_t sr_len;
+} vtap_dev_t;
+
+// called for every TCK with the pins and the state before the rising edge
+typedef void (*vtap_trace_fn)(void *ctx, int tms, int tdi, int tdo, jtag_state_t state);
+
+typedef struct vtap_chain
+{
+    int count;
+    vtap_dev_t devs[VTAP_MAX_DEVS];
+    jtag_state_t state;
+    int tdo_idle; // TDO outside Shift-IR/DR (pulled up on most boards)
+    uint64_t tck;
+    vtap_trace_fn trace;
+    void *trace_ctx;
+} vtap_chain_t;
+
+void vtap_init(vtap_chain_t *c);
+// adds a device with IDCODE and BYPASS, returns it so user regs can be added
+vtap_dev_t *vtap_add(vtap_chain_t *c, int ir_len, uint32_t idcode, uint32_t idcode_op);
+void vtap_add_user(vtap_dev_t *d, uint32_t opcode, int len, uint64_t value);
+// parses "irlen:idcode[:idcode_op],..." e.g. "6:0x0362d093:0x09,4:0"
+int vtap_parse(vtap_chain_t *c, const char *spec);
+void vtap_reset(vtap_chain_t *c);
+int vtap_clock(vtap_chain_t *c, int tms, int tdi);
+int vtap_shift(vtap_chain_t *c, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits);
+int vtap_idle(vtap_chain_t *c, int tms, uint32_t count);
+int vtap_repeat(vtap_chain_t *c, int tms, int tdi, uint32_t *tdo, uint32_t count);
+
+// backend wrapper, ctx is a vtap_chain_t
+extern const xvc_backend_t vtap_backend_ops;
+
+#endif
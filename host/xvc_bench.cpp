@@ -0,0 +1,659 @@
+// XVC 1.0 load generator and trace replayer.
+//
+//   xvc_bench [options] host[:port]
+//     -w tap|bitstream|mixed|runtest|config
+//                              synthetic workload (default mixed), runtest is
+//                              DR scans separated by long Run-Test/Idle and
+//                              Pause-DR waits, like an SVF RUNTEST flow,
+//                              config is full-buffer shifts of 101 word
+//                              frames, most of them blank
+//     -r FILE                  replay a shift trace instead
+//     -t                       keep the trace timing when replaying
+//     -n COUNT                 number of shifts (default 10000, replay: whole trace)
+//     -d DEPTH                 shifts kept in flight (default 1)
+//     -c HZ                    send settck: first
+//     -l                       expect tdo == tdi (tdi/tdo jumper or loopback backend)
+//     -o FILE                  save the generated shifts as a trace
+//     -s SEED                  random seed
+//     -S                       dump the server stats: histograms at the end
+//     -C                       dump the server shift path report (calib:)
+//                              at the end, this re-measures the paths
+//     -P                       record the run on the server (rec:), then
+//                              replay it there (play:) and print the result
+//     -z                       negotiate run-length coded shifts (codec:) and
+//                              send shiftz: whenever it is shorter than shift:
+//     -v cmp|crc               shifts with a known tdo are checked on the server:
+//                              shiftv: sends the expected tdo and a mask and
+//                              gets the first wrong bit back, shiftc: gets
+//                              the CRC-32 of the tdo (xvc_verify.h)
+//
+// Trace format, one shift per line, '#' starts a comment:
+//   <t_us> <nbits> <tms hex> <tdi hex> [<expected tdo hex>]
+// hex strings are the XVC payload bytes in wire order, byte 0 first.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "xvc_verify.h"
+#include "xvc_z.h"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+struct Shift
+{
+    uint64_t t_us = 0;
+    uint32_t nbits = 0;
+    std::vector<uint8_t> tms, tdi, tdo; // tdo empty: not checked
+};
+
+// same classes as the firmware histograms (xvc_stats.h)
+const uint32_t kClassMax[] = {32, 256, 2048, 16384};
+const int kClasses = 5;
+
+int len_class(uint32_t nbits)
+{
+    int i = 0;
+    while (i < kClasses - 1 && nbits > kClassMax[i])
+        i++;
+    return i;
+}
+
+std::string class_name(int c)
+{
+    if (c < kClasses - 1)
+        return "<=" + std::to_string(kClassMax[c]);
+    return ">" + std::to_string(kClassMax[kClasses - 2]);
+}
+
+class Conn
+{
+  public:
+    explicit Conn(const std::string &target)
+    {
+        std::string host = target, port = "2542";
+        auto colon = target.rfind(':');
+        if (colon != std::string::npos)
+        {
+            host = target.substr(0, colon);
+            port = target.substr(colon + 1);
+        }
+        addrinfo hints{}, *res = nullptr;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0)
+            die("cannot resolve " + target);
+        for (addrinfo *a = res; a && fd_ < 0; a = a->ai_next)
+        {
+            fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd_ >= 0 && connect(fd_, a->ai_addr, a->ai_addrlen) < 0)
+            {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        freeaddrinfo(res);
+        if (fd_ < 0)
+            die("cannot connect to " + target);
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    ~Conn() { close(fd_); }
+
+    void send_all(const void *data, size_t len)
+    {
+        auto p = static_cast<const uint8_t *>(data);
+        while (len)
+        {
+            ssize_t r = ::send(fd_, p, len, MSG_NOSIGNAL);
+            if (r <= 0)
+                die("send failed");
+            p += r;
+            len -= r;
+        }
+    }
+    void recv_all(void *data, size_t len)
+    {
+        auto p = static_cast<uint8_t *>(data);
+        while (len)
+        {
+            ssize_t r = ::recv(fd_, p, len, 0);
+            if (r <= 0)
+                die("connection closed by server");
+            p += r;
+            len -= r;
+        }
+    }
+    std::string recv_line()
+    {
+        std::string s;
+        char c = 0;
+        while (c != '\n')
+        {
+            recv_all(&c, 1);
+            s += c;
+        }
+        return s;
+    }
+
+    [[noreturn]] static void die(const std::string &msg)
+    {
+        fprintf(stderr, "xvc_bench: %s\n", msg.c_str());
+        exit(2);
+    }
+
+  private:
+    int fd_ = -1;
+};
+
+std::string to_hex(const std::vector<uint8_t> &v)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+    for (uint8_t b : v)
+    {
+        s += digits[b >> 4];
+        s += digits[b & 15];
+    }
+    return s;
+}
+
+std::vector<uint8_t> from_hex(const std::string &s, size_t nbytes)
+{
+    std::vector<uint8_t> v(nbytes);
+    for (size_t i = 0; i < nbytes && 2 * i + 1 < s.size(); i++)
+        v[i] = std::stoul(s.substr(2 * i, 2), nullptr, 16);
+    return v;
+}
+
+std::vector<Shift> load_trace(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in)
+        Conn::die("cannot open " + path);
+    std::vector<Shift> out;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream ls(line);
+        Shift s;
+        std::string tms, tdi, tdo;
+        if (!(ls >> s.t_us >> s.nbits >> tms >> tdi))
+            Conn::die("bad trace line: " + line);
+        // -t waits for each shift relative to the first one
+        if (!out.empty() && s.t_us < out.back().t_us)
+            Conn::die("trace time goes backwards: " + line);
+        size_t n = (s.nbits + 7) / 8;
+        s.tms = from_hex(tms, n);
+        s.tdi = from_hex(tdi, n);
+        if (ls >> tdo)
+            s.tdo = from_hex(tdo, n);
+        out.push_back(std::move(s));
+    }
+    return out;
+}
+
+void save_trace(const std::string &path, const std::vector<Shift> &shifts)
+{
+    std::ofstream out(path);
+    out << "# t_us nbits tms tdi [tdo]\n";
+    for (const Shift &s : shifts)
+    {
+        out << s.t_us << ' ' << s.nbits << ' ' << to_hex(s.tms) << ' ' << to_hex(s.tdi);
+        if (!s.tdo.empty())
+            out << ' ' << to_hex(s.tdo);
+        out << '\n';
+    }
+}
+
+Shift random_shift(std::mt19937 &rng, uint32_t nbits, bool exit_shift)
+{
+    Shift s;
+    s.nbits = nbits;
+    size_t n = (nbits + 7) / 8;
+    s.tms.resize(n);
+    s.tdi.resize(n);
+    for (size_t i = 0; i < n; i++)
+        s.tdi[i] = rng();
+    if (exit_shift)
+    {
+        // stay in Shift-DR and leave on the last bit, like a bitstream load
+        s.tms[(nbits - 1) / 8] = 1u << ((nbits - 1) % 8);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+            s.tms[i] = rng();
+    }
+    return s;
+}
+
+// DR scan from Run-Test/Idle with waits in Pause-DR and Run-Test/Idle,
+// starting with a TAP reset so the server can track the state
+Shift runtest_shift(std::mt19937 &rng, uint32_t max_bits)
+{
+    Shift s;
+    auto put = [&s](int tms, int tdi) {
+        size_t i = s.nbits++;
+        if (i / 8 >= s.tms.size())
+        {
+            s.tms.push_back(0);
+            s.tdi.push_back(0);
+        }
+        s.tms[i / 8] |= tms << (i % 8);
+        s.tdi[i / 8] |= tdi << (i % 8);
+    };
+    auto room = [&s, max_bits](uint32_t n) { return std::min(n, max_bits - 8 - s.nbits); };
+    for (int i = 0; i < 5; i++)
+        put(1, 0);
+    put(0, 0); // Run-Test/Idle
+    while (s.nbits + 48 < max_bits)
+    {
+        for (uint32_t i = room(rng() % 2000) / 2; i; i--)
+            put(0, rng() & 1);
+        put(1, 0), put(0, 0), put(0, 0); // Select-DR, Capture-DR, Shift-DR
+        for (uint32_t i = room(1 + rng() % 64) / 2; i; i--)
+            put(0, rng() & 1);
+        put(1, rng() & 1), put(0, 0); // Exit1-DR, Pause-DR
+        for (uint32_t i = room(rng() % 500) / 2; i; i--)
+            put(0, 0);
+        put(1, 0), put(1, 0), put(0, 0); // Exit2-DR, Update-DR, Run-Test/Idle
+    }
+    return s;
+}
+
+// 7 series configuration data: 101 word frames, mostly blank in a small
+// design, written in Shift-DR and leaving on the last bit
+Shift config_shift(std::mt19937 &rng, uint32_t max_bits)
+{
+    Shift s = random_shift(rng, max_bits, true);
+    const size_t frame = 101 * 4;
+    for (size_t f = 0; f < s.tdi.size(); f += frame)
+    {
+        if (rng() % 4)
+            std::fill(s.tdi.begin() + f, s.tdi.begin() + std::min(f + frame, s.tdi.size()), 0);
+    }
+    return s;
+}
+
+std::vector<Shift> generate(const std::string &workload, size_t count, uint32_t max_bits, std::mt19937 &rng)
+{
+    std::vector<Shift> out;
+    // every workload but tap has shifts of 33 bits up to the buffer
+    if (workload != "tap" && max_bits <= 32)
+        Conn::die("server buffer of " + std::to_string(max_bits) + " bits is too small for " + workload);
+    for (size_t i = 0; i < count; i++)
+    {
+        bool big;
+        if (workload == "config")
+        {
+            out.push_back(config_shift(rng, max_bits));
+            continue;
+        }
+        if (workload == "runtest")
+        {
+            out.push_back(runtest_shift(rng, max_bits));
+            continue;
+        }
+        if (workload == "tap")
+            big = false;
+        else if (workload == "bitstream")
+            big = true;
+        else if (workload == "mixed")
+            big = rng() % 10 == 0;
+        else
+            Conn::die("unknown workload " + workload);
+        uint32_t nbits = big ? (workload == "bitstream" ? max_bits : 33 + rng() % (max_bits - 32))
+                             : 1 + rng() % 32;
+        out.push_back(random_shift(rng, nbits, big));
+    }
+    return out;
+}
+
+bool tdo_matches(const Shift &s, const std::vector<uint8_t> &got)
+{
+    for (uint32_t i = 0; i < s.nbits; i += 8)
+    {
+        uint8_t mask = s.nbits - i >= 8 ? 0xff : (1u << (s.nbits - i)) - 1;
+        if ((s.tdo[i / 8] ^ got[i / 8]) & mask)
+            return false;
+    }
+    return true;
+}
+
+double percentile(std::vector<double> &v, double p)
+{
+    if (v.empty())
+        return 0;
+    size_t k = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: xvc_bench [-w tap|bitstream|mixed|runtest|config] [-r trace [-t]] [-n count] [-d depth]\n"
+                    "                 [-c tck_hz] [-l] [-o trace] [-s seed] [-S] [-C] [-P] [-z] [-v cmp|crc]\n"
+                    "                 host[:port]\n");
+    exit(1);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string workload = "mixed", replay, save, target, verify;
+    size_t count = 10000, depth = 1;
+    bool timed = false, loopback = false, server_stats = false, count_set = false, record = false, calib = false;
+    bool compress = false;
+    uint32_t tck = 0;
+    unsigned seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:r:tn:d:c:lo:s:SCPzv:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w': workload = optarg; break;
+        case 'r': replay = optarg; break;
+        case 't': timed = true; break;
+        case 'n': count = strtoul(optarg, nullptr, 0); count_set = true; break;
+        case 'd': depth = std::max(1ul, strtoul(optarg, nullptr, 0)); break;
+        case 'c': tck = strtoul(optarg, nullptr, 0); break;
+        case 'l': loopback = true; break;
+        case 'o': save = optarg; break;
+        case 's': seed = strtoul(optarg, nullptr, 0); break;
+        case 'S': server_stats = true; break;
+        case 'P': record = true; break;
+        case 'C': calib = true; break;
+        case 'z': compress = true; break;
+        case 'v': verify = optarg; break;
+        default: usage();
+        }
+    }
+    if (optind != argc - 1 || (!verify.empty() && verify != "cmp" && verify != "crc"))
+        usage();
+    target = argv[optind];
+
+    Conn conn(target);
+    conn.send_all("getinfo:", 8);
+    std::string info = conn.recv_line();
+    auto colon = info.find(':');
+    if (info.compare(0, 11, "xvcServer_v") != 0 || colon == std::string::npos)
+        Conn::die("unexpected getinfo reply: " + info);
+    uint32_t max_bytes = std::stoul(info.substr(colon + 1));
+    uint32_t max_bits = max_bytes / 2 * 8;
+    printf("server %s", info.c_str());
+
+    if (tck)
+    {
+        uint8_t cmd[11] = {'s', 'e', 't', 't', 'c', 'k', ':'};
+        uint32_t period = 1000000000u / tck;
+        memcpy(cmd + 7, &period, 4);
+        conn.send_all(cmd, sizeof(cmd));
+        conn.recv_all(&period, 4);
+        printf("tck period %u ns\n", period);
+    }
+
+    if (compress)
+    {
+        // a server without the extension drops the connection here
+        uint8_t codec = 0;
+        conn.send_all("codec:\x01", 7);
+        conn.recv_all(&codec, 1);
+        if (codec != XVC_Z_RLE)
+            Conn::die("server declined codec " + std::to_string(XVC_Z_RLE));
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<Shift> shifts;
+    if (!replay.empty())
+    {
+        shifts = load_trace(replay);
+        if (count_set && count < shifts.size())
+            shifts.resize(count);
+    }
+    else
+    {
+        shifts = generate(workload, count, max_bits, rng);
+    }
+    for (Shift &s : shifts)
+    {
+        if ((s.nbits + 7) / 8 * 2 > max_bytes || s.nbits == 0)
+            Conn::die("shift of " + std::to_string(s.nbits) + " bits does not fit the server buffer");
+        if (loopback && s.tdo.empty())
+            s.tdo = s.tdi;
+    }
+
+    int32_t reply[2];
+    if (record)
+    {
+        conn.send_all("rec:\x01", 5);
+        conn.recv_all(reply, 4);
+    }
+
+    std::vector<double> lat[kClasses];
+    size_t bad = 0, checked = 0, zshifts = 0, vshifts = 0;
+    uint64_t bits = 0, bytes = 0, raw_bytes = 0, tdo_saved = 0;
+    struct Sent
+    {
+        size_t idx;
+        clock_type::time_point t;
+        char kind; // ':' shift:, 'z' shiftz:, 'v' shiftv:, 'c' shiftc:
+    };
+    std::deque<Sent> inflight;
+    std::vector<uint8_t> tdo, z(4 + XVC_Z_BOUND(max_bytes)), ztdo(XVC_Z_BOUND(max_bytes)), mask(max_bytes / 2, 0xff);
+    auto start = clock_type::now();
+    size_t next = 0;
+
+    auto complete = [&]() {
+        auto [idx, sent, kind] = inflight.front();
+        inflight.pop_front();
+        Shift &s = shifts[idx];
+        tdo.resize((s.nbits + 7) / 8);
+        if (kind == 'v' || kind == 'c')
+        {
+            // the verdict of the server instead of the tdo
+            uint32_t res;
+            conn.recv_all(&res, 4);
+            bytes += 4;
+            lat[len_class(s.nbits)].push_back(
+                std::chrono::duration<double, std::micro>(clock_type::now() - sent).count());
+            std::vector<uint8_t> words((s.nbits + 31) / 32 * 4);
+            std::copy(s.tdo.begin(), s.tdo.end(), words.begin());
+            if (s.nbits % 8)
+                words[s.tdo.size() - 1] &= (1u << (s.nbits % 8)) - 1;
+            uint32_t want = kind == 'v' ? ~0u : xvc_crc32(words.data(), words.size());
+            checked++;
+            if (res != want && bad++ == 0)
+            {
+                if (kind == 'v')
+                    fprintf(stderr, "shiftv: tdo bit %u wrong at shift %zu (%u bits)\n", res, idx, s.nbits);
+                else
+                    fprintf(stderr, "shiftc: crc %08x, want %08x at shift %zu (%u bits)\n", res, want, idx, s.nbits);
+            }
+            return;
+        }
+        if (kind == 'z')
+        {
+            uint32_t zlen;
+            conn.recv_all(&zlen, 4);
+            if (zlen > ztdo.size())
+                Conn::die("shiftz: reply of " + std::to_string(zlen) + " bytes");
+            conn.recv_all(ztdo.data(), zlen);
+            if (xvc_z_decode(tdo.data(), tdo.size(), ztdo.data(), zlen) != (int)zlen)
+                Conn::die("bad shiftz: reply");
+            bytes += 4 + zlen;
+        }
+        else
+        {
+            conn.recv_all(tdo.data(), tdo.size());
+            bytes += tdo.size();
+        }
+        auto now = clock_type::now();
+        lat[len_class(s.nbits)].push_back(std::chrono::duration<double, std::micro>(now - sent).count());
+        if (!s.tdo.empty())
+        {
+            checked++;
+            if (!tdo_matches(s, tdo) && bad++ == 0)
+                fprintf(stderr, "tdo mismatch at shift %zu (%u bits)\n  want %s\n  got  %s\n", idx, s.nbits,
+                        to_hex(s.tdo).c_str(), to_hex(tdo).c_str());
+        }
+        if (save.size() && s.tdo.empty())
+            s.tdo = tdo;
+    };
+
+    while (next < shifts.size() || !inflight.empty())
+    {
+        if (next < shifts.size() && inflight.size() < depth)
+        {
+            Shift &s = shifts[next];
+            if (timed)
+            {
+                auto due = start + std::chrono::microseconds(s.t_us - shifts[0].t_us);
+                if (clock_type::now() < due)
+                {
+                    if (!inflight.empty())
+                        complete();
+                    else
+                        std::this_thread::sleep_until(due);
+                    continue;
+                }
+            }
+            else
+            {
+                s.t_us = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count();
+            }
+            // shiftz: | len | zlen | coded tms | coded tdi, when that is shorter
+            int n = s.tms.size(), zlen = -1;
+            char kind = verify.empty() || s.tdo.empty() ? ':' : verify == "cmp" ? 'v' : 'c';
+            if (compress && kind == ':')
+            {
+                int k = xvc_z_encode(z.data() + 15, z.size() - 15, s.tms.data(), n);
+                int m = k < 0 ? -1 : xvc_z_encode(z.data() + 15 + k, z.size() - 15 - k, s.tdi.data(), n);
+                zlen = m < 0 || 15 + k + m >= 10 + 2 * n ? -1 : k + m;
+            }
+            if (kind != ':')
+            {
+                // shiftv: | len | tms | tdi | expected tdo | mask, shiftc: | len | tms | tdi
+                uint8_t hdr[11] = {'s', 'h', 'i', 'f', 't', (uint8_t)kind, ':'};
+                memcpy(hdr + 7, &s.nbits, 4);
+                conn.send_all(hdr, sizeof(hdr));
+                conn.send_all(s.tms.data(), n);
+                conn.send_all(s.tdi.data(), n);
+                bytes += sizeof(hdr) + 2 * n;
+                if (kind == 'v')
+                {
+                    conn.send_all(s.tdo.data(), n);
+                    conn.send_all(mask.data(), n);
+                    bytes += 2 * n;
+                }
+                vshifts++;
+                tdo_saved += n;
+            }
+            else if (zlen > 0)
+            {
+                kind = 'z';
+                memcpy(z.data(), "shiftz:", 7);
+                memcpy(z.data() + 7, &s.nbits, 4);
+                memcpy(z.data() + 11, &zlen, 4);
+                conn.send_all(z.data(), 15 + zlen);
+                bytes += 15 + zlen;
+                zshifts++;
+            }
+            else
+            {
+                uint8_t hdr[10] = {'s', 'h', 'i', 'f', 't', ':'};
+                memcpy(hdr + 6, &s.nbits, 4);
+                conn.send_all(hdr, sizeof(hdr));
+                conn.send_all(s.tms.data(), n);
+                conn.send_all(s.tdi.data(), n);
+                bytes += sizeof(hdr) + 2 * n;
+            }
+            inflight.push_back({next++, clock_type::now(), kind});
+            bits += s.nbits;
+            raw_bytes += 10 + 3 * n;
+        }
+        else
+        {
+            complete();
+        }
+    }
+    double secs = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    printf("%zu shifts, %llu bits in %.3f s: %.0f shifts/s, %.3f Mbit/s tck, %.1f kB/s on the wire\n",
+           shifts.size(), (unsigned long long)bits, secs, shifts.size() / secs, bits / secs / 1e6,
+           bytes / secs / 1e3);
+    if (compress)
+        printf("shiftz: %zu of %zu shifts coded, %llu wire bytes for %llu raw (%.2fx), %.3f tck bits per wire bit\n",
+               zshifts, shifts.size(), (unsigned long long)bytes, (unsigned long long)raw_bytes,
+               (double)raw_bytes / bytes, bits / (8.0 * bytes));
+    if (!verify.empty())
+        printf("shift%c: %zu of %zu shifts checked on the server, %llu tdo bytes not sent\n", verify == "cmp" ? 'v' : 'c',
+               vshifts, shifts.size(), (unsigned long long)tdo_saved);
+    printf("%-8s %8s %10s %10s %10s\n", "bits", "shifts", "p50 us", "p99 us", "p999 us");
+    for (int c = 0; c < kClasses; c++)
+    {
+        if (lat[c].empty())
+            continue;
+        size_t n = lat[c].size();
+        double p50 = percentile(lat[c], 0.5), p99 = percentile(lat[c], 0.99), p999 = percentile(lat[c], 0.999);
+        printf("%-8s %8zu %10.1f %10.1f %10.1f\n", class_name(c).c_str(), n, p50, p99, p999);
+    }
+    if (checked)
+        printf("tdo check: %zu of %zu shifts wrong\n", bad, checked);
+
+    if (!save.empty())
+        save_trace(save, shifts);
+
+    if (record)
+    {
+        conn.send_all("rec:\x00", 5);
+        conn.recv_all(reply, 4);
+        printf("recorded %d shifts\n", reply[0]);
+        auto t0 = clock_type::now();
+        conn.send_all("play:", 5);
+        conn.recv_all(reply, 8);
+        printf("replayed %d shifts in %.3f s, %d tdo mismatches\n", reply[0],
+               std::chrono::duration<double>(clock_type::now() - t0).count(), reply[1]);
+        if (reply[0] < 0 || reply[1])
+            bad++;
+    }
+
+    if (server_stats)
+    {
+        uint32_t len;
+        conn.send_all("stats:", 6);
+        conn.recv_all(&len, 4);
+        std::string text(len, '\0');
+        conn.recv_all(text.data(), len);
+        printf("%s", text.c_str());
+    }
+    if (calib)
+    {
+        uint32_t len;
+        conn.send_all("calib:", 6);
+        conn.recv_all(&len, 4);
+        std::string text(len, '\0');
+        conn.recv_all(text.data(), len);
+        printf("%s", text.c_str());
+    }
+    return bad ? 1 : 0;
+}
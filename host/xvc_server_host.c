@@ -0,0 +1,359 @@
+// The firmware XVC engine (xvc_server.c) on POSIX sockets, for profiling the
+// parser and buffering on a desktop.
+//   xvc_server_host [-p port] [-b backend] [-c chain] [-x tck.trace] [-i] [-R] [-V] [-T shifts]
+// backends:
+//   loopback  tdo = tdi, word at a time with the tail handling of tdata.pio
+//   fifo      loopback through the async shift engine (xfer_queue.c) and a
+//             fake of the pio fifos, -T also runs a pipelined order check
+//   vtap      virtual TAP chain, -c "irlen:idcode[:idcode_op],..." (default
+//             one xc7a35t with a 32 bit USER1 register), -x logs every TCK
+// -i puts the firmware TAP tracker (tap_track.c) in front of the backend
+// -D routes loopback shifts to the loopback or the fifo backend, whichever
+//    measured faster for the length (xvc_dispatch.c), calib: re-measures
+// -R splits shifts into literal and constant TDI/TMS repeat segments (tdi_rle.c)
+// -V checks every TDO vector against a second, plain vtap chain
+// -T runs that many random shifts through the backend, prints the rate and exits
+// -J checks the TAP operation layer (jtag_ops.c) with that many random ops and exits
+// -C checks the checksum kernels (xvc_chksum.c) on that many random buffers and exits
+// -K checks the shift caches (shift_cache.c) with that many repeated shifts and exits
+// -L checks that the server refuses bad shift lengths and exits
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "xvc_server.h"
+#include "xvc_stats.h"
+#include "backends.h"
+#include "vtap.h"
+#include "tap_track.h"
+#include "tdi_rle.h"
+#include "xvc_rec.h"
+#include "xvc_dispatch.h"
+#include "xfer_chain.h"
+
+static vtap_chain_t chain, ref_chain;
+static xvc_backend_t vtap_backend, ref_backend;
+static tap_track_t tap;
+static tdi_rle_t rle;
+static verify_backend_t verify;
+static xvc_rec_t rec;
+static xvc_dispatch_t dispatch;
+
+// recorder store in RAM with flash semantics: erase sets bits, program clears them
+static uint8_t rec_mem[1024 * 1024];
+
+static int rec_mem_erase(uint32_t off, uint32_t len)
+{
+    memset(rec_mem + off, 0xff, len);
+    return 0;
+}
+
+static int rec_mem_program(uint32_t off, const void *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        rec_mem[off + i] &= ((const uint8_t *)data)[i];
+    return 0;
+}
+
+static const xvc_rec_store_t rec_mem_store = {rec_mem, sizeof(rec_mem), rec_mem_erase, rec_mem_program};
+
+static int sock_read(void *ctx, void *buf, int len)
+{
+    int r = recv((int)(intptr_t)ctx, buf, len, MSG_DONTWAIT);
+    if (r > 0)
+        return r;
+    if (r < 0 && (errno == EWOULDBLOCK || errno == EAGAIN))
+        return 0;
+    return -1;
+}
+
+static int sock_write(void *ctx, const void *buf, int len)
+{
+    return send((int)(intptr_t)ctx, buf, len, MSG_NOSIGNAL);
+}
+
+static const xvc_backend_t *pick_backend(const char *name)
+{
+    if (strcmp(name, "loopback") == 0)
+        return &loopback_backend;
+    if (strcmp(name, "vtap") == 0)
+        return &vtap_backend;
+    if (strcmp(name, "fifo") == 0)
+        return &fifo_backend;
+    if (strcmp(name, "chain") == 0)
+        return &chain_backend;
+    return NULL;
+}
+
+static int calibrate(char *text, int size)
+{
+    xvc_dispatch_calibrate(&dispatch);
+    tap_track_reset(&tap);
+    return xvc_dispatch_report(&dispatch, text, size);
+}
+
+static void trace_tck(void *ctx, int tms, int tdi, int tdo, jtag_state_t state)
+{
+    fprintf(ctx, "%llu %s %d %d %d\n", (unsigned long long)chain.tck, jtag_state_name(state), tms, tdi, tdo);
+}
+
+static void bench(const xvc_backend_t *b, long count)
+{
+    uint32_t tms[2], tdi[2], tdo[2];
+    uint64_t bits = 0;
+    struct timespec t0, t1;
+    srand(1);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < count; i++)
+    {
+        int nbits = 1 + rand() % 64;
+        tms[0] = rand();
+        tms[1] = rand();
+        tdi[0] = rand();
+        tdi[1] = rand();
+        b->shift(b->ctx, tms, tdi, tdo, nbits);
+        bits += nbits;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%ld shifts, %llu bits in %.3f s: %.2f M shifts/s, %.1f Mbit/s\n", count,
+           (unsigned long long)bits, secs, count / secs / 1e6, bits / secs / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    int port = 2542, opt;
+    long bench_count = 0, stall_every = 0, ops_count = 0, chksum_count = 0, cache_count = 0;
+    int use_track = 0, use_rle = 0, use_verify = 0, use_dispatch = 0, len_check = 0;
+    const char *backend_name = "loopback", *spec = NULL, *trace = NULL;
+    while ((opt = getopt(argc, argv, "p:b:c:x:iRVDT:S:J:C:K:L")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': port = atoi(optarg); break;
+        case 'b': backend_name = optarg; break;
+        case 'c': spec = optarg; break;
+        case 'x': trace = optarg; break;
+        case 'i': use_track = 1; break;
+        case 'R': use_rle = 1; break;
+        case 'D': use_dispatch = 1; break;
+        case 'V': use_verify = 1; break;
+        case 'T': bench_count = atol(optarg); break;
+        case 'S': stall_every = atol(optarg); break;
+        case 'J': ops_count = atol(optarg); break;
+        case 'C': chksum_count = atol(optarg); break;
+        case 'K': cache_count = atol(optarg); break;
+        case 'L': len_check = 1; break;
+        default:
+            fprintf(stderr, "usage: xvc_server_host [-p port] [-b loopback|vtap|fifo|chain] [-c chain] [-x tck.trace] [-i] [-R] [-V] [-D] [-T shifts] [-S n] [-J ops] [-C buffers] [-K shifts] [-L]\n");
+            return 1;
+        }
+    }
+    if (ops_count)
+        return jtag_ops_check(ops_count) < 0;
+    if (chksum_count)
+        return chksum_check(chksum_count) < 0;
+    if (cache_count)
+        return shift_cache_check(cache_count) < 0;
+    if (len_check)
+        return server_check() < 0;
+
+    vtap_init(&chain);
+    if (spec)
+    {
+        if (vtap_parse(&chain, spec) < 0)
+        {
+            fprintf(stderr, "bad chain %s\n", spec);
+            return 1;
+        }
+    }
+    else
+    {
+        vtap_add_user(vtap_add(&chain, 6, 0x0362d093, 0x09), 0x02, 32, 0);
+    }
+    if (trace)
+    {
+        chain.trace = trace_tck;
+        chain.trace_ctx = fopen(trace, "w");
+        if (!chain.trace_ctx)
+        {
+            perror(trace);
+            return 1;
+        }
+    }
+    vtap_backend = vtap_backend_ops;
+    vtap_backend.ctx = &chain;
+
+    const xvc_backend_t *backend = pick_backend(backend_name);
+    if (!backend)
+    {
+        fprintf(stderr, "unknown backend %s\n", backend_name);
+        return 1;
+    }
+    // the reference chain is a copy taken before any TCK, traced or not
+    ref_chain = chain;
+    ref_chain.trace = NULL;
+    ref_backend = vtap_backend_ops;
+    ref_backend.ctx = &ref_chain;
+    if (use_dispatch)
+    {
+        xvc_dispatch_init(&dispatch);
+        xvc_dispatch_add(&dispatch, "loopback", &loopback_backend, 0);
+        xvc_dispatch_add(&dispatch, "fifo", &fifo_backend, 0);
+        xvc_dispatch_calibrate(&dispatch);
+        backend = &dispatch.backend;
+        char text[2048];
+        xvc_dispatch_report(&dispatch, text, sizeof(text));
+        printf("%s", text);
+    }
+    if (use_rle)
+    {
+        tdi_rle_init(&rle, backend);
+        backend = &rle.backend;
+    }
+    if (use_track)
+    {
+        tap_track_init(&tap, backend);
+        backend = &tap.backend;
+    }
+    if (use_verify)
+    {
+        if (backend == &loopback_backend)
+        {
+            fprintf(stderr, "-V compares against vtap, use -b vtap\n");
+            return 1;
+        }
+        verify_backend_init(&verify, backend, &ref_backend);
+        backend = &verify.backend;
+    }
+    fifo_stall_every(stall_every);
+    if (bench_count)
+    {
+        bench(backend, bench_count);
+        if (stall_every)
+        {
+            printf("xfer_queue: %lu shifts timed out\n", (unsigned long)xvc_counters.shift_timeouts);
+            fifo_stall_every(0);
+        }
+        if (strcmp(backend_name, "fifo") == 0)
+        {
+            int r = fifo_pipeline_check(bench_count);
+            printf("xfer_queue: %ld pipelined requests, %s\n", bench_count, r ? "tdo mismatch" : "in order, tdo ok");
+            if (r)
+                return 1;
+            r = fifo_irq_check(bench_count);
+            printf("xfer_queue: %ld event driven requests, %s\n", bench_count, r ? "tdo mismatch" : "tdo ok");
+            if (r)
+                return 1;
+        }
+        if (strcmp(backend_name, "chain") == 0)
+        {
+            int r = chain_batch_check(bench_count);
+            printf("xfer_chain: %ld shifts in chains of up to %d, %s\n", bench_count, XFER_CHAIN_MAX,
+                   r ? "tdo mismatch" : "tdo ok");
+            if (r)
+                return 1;
+        }
+        if (use_verify)
+            printf("verify: %llu mismatches\n", (unsigned long long)verify.mismatches);
+        return verify.mismatches != 0;
+    }
+
+    int s = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    struct sockaddr_in address = {0};
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    address.sin_family = AF_INET;
+    if (bind(s, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(s, XVC_MAX_CONN) < 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    printf("xvc server on port %d, backend %s\n", port, backend_name);
+
+    static xvc_server_t xvc;
+    xvc_rec_init(&rec, backend, &rec_mem_store);
+    if (use_track)
+        rec.track = &tap;
+    xvc_server_init(&xvc, &rec.backend);
+    xvc.rec = &rec;
+    if (use_dispatch)
+        xvc.calibrate = calibrate;
+    xvc_stats_reset();
+    // one poll() loop like the firmware select() loop, XVC_MAX_CONN clients
+    static xvc_conn_t conns[XVC_MAX_CONN];
+    struct pollfd fds[1 + XVC_MAX_CONN];
+    fds[0].fd = s;
+    fds[0].events = POLLIN;
+    for (int i = 1; i <= XVC_MAX_CONN; i++)
+    {
+        fds[i].fd = -1;
+        fds[i].events = POLLIN;
+    }
+    while (1)
+    {
+        if (poll(fds, 1 + XVC_MAX_CONN, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(s, NULL, NULL), i = 1;
+            while (i <= XVC_MAX_CONN && fds[i].fd >= 0)
+                i++;
+            if (fd >= 0 && i > XVC_MAX_CONN)
+            {
+                close(fd);
+            }
+            else if (fd >= 0)
+            {
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+                struct timeval tv = {XVC_SEND_TIMEOUT_MS / 1000, XVC_SEND_TIMEOUT_MS % 1000 * 1000};
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+                fds[i].fd = fd;
+                xvc_conn_init(&conns[i - 1]);
+            }
+        }
+        for (int i = 1; i <= XVC_MAX_CONN; i++)
+        {
+            if (fds[i].fd < 0 || !fds[i].revents)
+                continue;
+            xvc_transport_t t = {.ctx = (void *)(intptr_t)fds[i].fd, .read = sock_read, .write = sock_write};
+            if (xvc_server_feed(&xvc, &conns[i - 1], &t) == 0)
+                continue;
+            close(fds[i].fd);
+            fds[i].fd = -1;
+            if (chain.trace_ctx)
+                fflush(chain.trace_ctx);
+            if (use_verify)
+                printf("verify: %llu shifts, %llu mismatches\n", (unsigned long long)verify.shifts,
+                       (unsigned long long)verify.mismatches);
+            if (use_rle)
+                printf("tdi_rle: %lu repeats, %llu bits, %llu fifo words saved, %lu of %lu cached\n",
+                       (unsigned long)xvc_counters.rle_runs, (unsigned long long)xvc_counters.rle_bits,
+                       (unsigned long long)xvc_counters.rle_words_saved, (unsigned long)rle.cache.hits,
+                       (unsigned long)(rle.cache.hits + rle.cache.misses));
+            if (stall_every)
+                printf("xfer_queue: %lu shifts timed out\n", (unsigned long)xvc_counters.shift_timeouts);
+            if (use_track)
+                printf("tap_track: %lu idle runs, %llu idle bits, %lu of %lu cached\n",
+                       (unsigned long)xvc_counters.idle_runs, (unsigned long long)xvc_counters.idle_bits,
+                       (unsigned long)tap.cache.hits, (unsigned long)(tap.cache.hits + tap.cache.misses));
+            fflush(stdout);
+        }
+    }
+}
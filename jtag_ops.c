@@ -0,0 +1,252 @@
+#include "jtag_ops.h"
+#include <string.h>
+
+#include "bitvec.h"
+
+#define P(len, tms) {len, tms}
+
+// breadth first search over jtag_next_state, tms=0 tried first; columns in
+// jtag_state_t order, host -J checks every entry against jtag_step()
+const jtag_path_t jtag_paths[JTAG_STATE_COUNT][JTAG_STATE_COUNT] = {
+    [JTAG_TEST_LOGIC_RESET] = {
+        P(0, 0x00), P(1, 0x00), P(2, 0x02), P(3, 0x02), P(4, 0x02), P(4, 0x0a), P(5, 0x0a), P(6, 0x2a),
+        P(5, 0x1a), P(3, 0x06), P(4, 0x06), P(5, 0x06), P(5, 0x16), P(6, 0x16), P(7, 0x56), P(6, 0x36),
+    },
+    [JTAG_RUN_TEST_IDLE] = {
+        P(3, 0x07), P(0, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x01), P(3, 0x05), P(4, 0x05), P(5, 0x15),
+        P(4, 0x0d), P(2, 0x03), P(3, 0x03), P(4, 0x03), P(4, 0x0b), P(5, 0x0b), P(6, 0x2b), P(5, 0x1b),
+    },
+    [JTAG_SELECT_DR_SCAN] = {
+        P(2, 0x03), P(3, 0x03), P(0, 0x00), P(1, 0x00), P(2, 0x00), P(2, 0x02), P(3, 0x02), P(4, 0x0a),
+        P(3, 0x06), P(1, 0x01), P(2, 0x01), P(3, 0x01), P(3, 0x05), P(4, 0x05), P(5, 0x15), P(4, 0x0d),
+    },
+    [JTAG_CAPTURE_DR] = {
+        P(5, 0x1f), P(3, 0x03), P(3, 0x07), P(0, 0x00), P(1, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x05),
+        P(2, 0x03), P(4, 0x0f), P(5, 0x0f), P(6, 0x0f), P(6, 0x2f), P(7, 0x2f), P(8, 0xaf), P(7, 0x6f),
+    },
+    [JTAG_SHIFT_DR] = {
+        P(5, 0x1f), P(3, 0x03), P(3, 0x07), P(4, 0x07), P(0, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x05),
+        P(2, 0x03), P(4, 0x0f), P(5, 0x0f), P(6, 0x0f), P(6, 0x2f), P(7, 0x2f), P(8, 0xaf), P(7, 0x6f),
+    },
+    [JTAG_EXIT1_DR] = {
+        P(4, 0x0f), P(2, 0x01), P(2, 0x03), P(3, 0x03), P(3, 0x02), P(0, 0x00), P(1, 0x00), P(2, 0x02),
+        P(1, 0x01), P(3, 0x07), P(4, 0x07), P(5, 0x07), P(5, 0x17), P(6, 0x17), P(7, 0x57), P(6, 0x37),
+    },
+    [JTAG_PAUSE_DR] = {
+        P(5, 0x1f), P(3, 0x03), P(3, 0x07), P(4, 0x07), P(2, 0x01), P(3, 0x05), P(0, 0x00), P(1, 0x01),
+        P(2, 0x03), P(4, 0x0f), P(5, 0x0f), P(6, 0x0f), P(6, 0x2f), P(7, 0x2f), P(8, 0xaf), P(7, 0x6f),
+    },
+    [JTAG_EXIT2_DR] = {
+        P(4, 0x0f), P(2, 0x01), P(2, 0x03), P(3, 0x03), P(1, 0x00), P(2, 0x02), P(3, 0x02), P(0, 0x00),
+        P(1, 0x01), P(3, 0x07), P(4, 0x07), P(5, 0x07), P(5, 0x17), P(6, 0x17), P(7, 0x57), P(6, 0x37),
+    },
+    [JTAG_UPDATE_DR] = {
+        P(3, 0x07), P(1, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x01), P(3, 0x05), P(4, 0x05), P(5, 0x15),
+        P(0, 0x00), P(2, 0x03), P(3, 0x03), P(4, 0x03), P(4, 0x0b), P(5, 0x0b), P(6, 0x2b), P(5, 0x1b),
+    },
+    [JTAG_SELECT_IR_SCAN] = {
+        P(1, 0x01), P(2, 0x01), P(3, 0x05), P(4, 0x05), P(5, 0x05), P(5, 0x15), P(6, 0x15), P(7, 0x55),
+        P(6, 0x35), P(0, 0x00), P(1, 0x00), P(2, 0x00), P(2, 0x02), P(3, 0x02), P(4, 0x0a), P(3, 0x06),
+    },
+    [JTAG_CAPTURE_IR] = {
+        P(5, 0x1f), P(3, 0x03), P(3, 0x07), P(4, 0x07), P(5, 0x07), P(5, 0x17), P(6, 0x17), P(7, 0x57),
+        P(6, 0x37), P(4, 0x0f), P(0, 0x00), P(1, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x05), P(2, 0x03),
+    },
+    [JTAG_SHIFT_IR] = {
+        P(5, 0x1f), P(3, 0x03), P(3, 0x07), P(4, 0x07), P(5, 0x07), P(5, 0x17), P(6, 0x17), P(7, 0x57),
+        P(6, 0x37), P(4, 0x0f), P(5, 0x0f), P(0, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x05), P(2, 0x03),
+    },
+    [JTAG_EXIT1_IR] = {
+        P(4, 0x0f), P(2, 0x01), P(2, 0x03), P(3, 0x03), P(4, 0x03), P(4, 0x0b), P(5, 0x0b), P(6, 0x2b),
+        P(5, 0x1b), P(3, 0x07), P(4, 0x07), P(3, 0x02), P(0, 0x00), P(1, 0x00), P(2, 0x02), P(1, 0x01),
+    },
+    [JTAG_PAUSE_IR] = {
+        P(5, 0x1f), P(3, 0x03), P(3, 0x07), P(4, 0x07), P(5, 0x07), P(5, 0x17), P(6, 0x17), P(7, 0x57),
+        P(6, 0x37), P(4, 0x0f), P(5, 0x0f), P(2, 0x01), P(3, 0x05), P(0, 0x00), P(1, 0x01), P(2, 0x03),
+    },
+    [JTAG_EXIT2_IR] = {
+        P(4, 0x0f), P(2, 0x01), P(2, 0x03), P(3, 0x03), P(4, 0x03), P(4, 0x0b), P(5, 0x0b), P(6, 0x2b),
+        P(5, 0x1b), P(3, 0x07), P(4, 0x07), P(1, 0x00), P(2, 0x02), P(3, 0x02), P(0, 0x00), P(1, 0x01),
+    },
+    [JTAG_UPDATE_IR] = {
+        P(3, 0x07), P(1, 0x00), P(1, 0x01), P(2, 0x01), P(3, 0x01), P(3, 0x05), P(4, 0x05), P(5, 0x15),
+        P(4, 0x0d), P(2, 0x03), P(3, 0x03), P(4, 0x03), P(4, 0x0b), P(5, 0x0b), P(6, 0x2b), P(0, 0x00),
+    },
+};
+
+#undef P
+
+static int fail(jtag_ops_t *o, int r)
+{
+    o->known = false;
+    return r;
+}
+
+static int tck(jtag_ops_t *o, int tms)
+{
+    if (o->nbits == JTAG_OPS_BITS)
+    {
+        int r = jtag_ops_flush(o);
+        if (r < 0)
+            return r;
+    }
+    if (tms)
+        o->tms[o->nbits >> 5] |= 1u << (o->nbits & 31);
+    o->nbits++;
+    o->state = jtag_step(o->state, tms);
+    return 0;
+}
+
+static int walk(jtag_ops_t *o, jtag_state_t s)
+{
+    int r = 0;
+    if (!o->known)
+    {
+        for (int i = 0; i < 5 && r >= 0; i++)
+            r = tck(o, 1);
+        o->state = JTAG_TEST_LOGIC_RESET;
+        o->known = r >= 0;
+    }
+    if (o->state == s)
+    {
+        o->skipped++;
+        return r;
+    }
+    jtag_path_t p = jtag_paths[o->state][s];
+    for (int i = 0; i < p.len && r >= 0; i++)
+        r = tck(o, (p.tms >> i) & 1);
+    return r;
+}
+
+int jtag_ops_flush(jtag_ops_t *o)
+{
+    int n = o->nbits, words = (n + 31) / 32;
+    if (!n)
+        return 0;
+    int r = o->lower->shift(o->lower->ctx, o->tms, o->tdi, o->tdo, n);
+    o->runs++;
+    o->bits += n;
+    o->nbits = 0;
+    // tdi is not needed any more, it lines the captured bits up on bit 0
+    for (int i = 0; i < o->ncap && r >= 0; i++)
+    {
+        jtag_capture_t *c = &o->cap[i];
+        bitvec_extract(o->tdi, o->tdo, c->src_off, c->n);
+        bitvec_insert(c->dst, c->dst_off, o->tdi, c->n);
+    }
+    o->ncap = 0;
+    memset(o->tms, 0, words * 4);
+    memset(o->tdi, 0, words * 4);
+    return r < 0 ? fail(o, r) : 0;
+}
+
+int jtag_ops_reset(jtag_ops_t *o)
+{
+    int r = 0;
+    o->ops++;
+    if (o->known && o->state == JTAG_TEST_LOGIC_RESET)
+    {
+        o->skipped++;
+        return 0;
+    }
+    for (int i = 0; i < 5 && r >= 0; i++)
+        r = tck(o, 1);
+    o->state = JTAG_TEST_LOGIC_RESET;
+    o->known = r >= 0;
+    return r;
+}
+
+int jtag_ops_goto(jtag_ops_t *o, jtag_state_t s)
+{
+    o->ops++;
+    return walk(o, s);
+}
+
+static int scan(jtag_ops_t *o, jtag_state_t shift, const uint32_t *tdi, uint32_t *tdo, int n, jtag_state_t end)
+{
+    int r;
+    o->ops++;
+    if (n < 1)
+        return -1;
+    if ((r = walk(o, shift)) < 0)
+        return r;
+    for (int done = 0; done < n;)
+    {
+        if (o->nbits == JTAG_OPS_BITS || (tdo && o->ncap == JTAG_OPS_MAX_CAPTURES))
+        {
+            if ((r = jtag_ops_flush(o)) < 0)
+                return r;
+        }
+        int len = n - done < JTAG_OPS_BITS - o->nbits ? n - done : JTAG_OPS_BITS - o->nbits;
+        if (tdi && done)
+        {
+            // pending tdo is scratch until the next run
+            bitvec_extract(o->tdo, tdi, done, len);
+            bitvec_insert(o->tdi, o->nbits, o->tdo, len);
+        }
+        else if (tdi)
+        {
+            bitvec_insert(o->tdi, o->nbits, tdi, len);
+        }
+        if (tdo)
+            o->cap[o->ncap++] = (jtag_capture_t){tdo, done, o->nbits, len};
+        o->nbits += len;
+        done += len;
+    }
+    // the last bit leaves the shift state unless the scan ends in it
+    if (end != shift)
+    {
+        o->tms[(o->nbits - 1) >> 5] |= 1u << ((o->nbits - 1) & 31);
+        o->state = jtag_step(shift, 1);
+    }
+    return walk(o, end);
+}
+
+int jtag_ops_scan_ir(jtag_ops_t *o, const uint32_t *tdi, uint32_t *tdo, int n, jtag_state_t end)
+{
+    return scan(o, JTAG_SHIFT_IR, tdi, tdo, n, end);
+}
+
+int jtag_ops_scan_dr(jtag_ops_t *o, const uint32_t *tdi, uint32_t *tdo, int n, jtag_state_t end)
+{
+    return scan(o, JTAG_SHIFT_DR, tdi, tdo, n, end);
+}
+
+int jtag_ops_runtest(jtag_ops_t *o, uint32_t clocks, jtag_state_t end)
+{
+    const xvc_backend_t *l = o->lower;
+    int r;
+    o->ops++;
+    if ((r = walk(o, JTAG_RUN_TEST_IDLE)) < 0)
+        return r;
+    if (clocks >= JTAG_OPS_MIN_IDLE && l->idle)
+    {
+        // tms stays 0, the engine counts the clocks
+        if ((r = jtag_ops_flush(o)) < 0)
+            return r;
+        r = l->idle(l->ctx, 0, clocks);
+        o->runs++;
+        o->bits += clocks;
+        if (r < 0)
+            return fail(o, r);
+        clocks = 0;
+    }
+    while (clocks)
+    {
+        if (o->nbits == JTAG_OPS_BITS && (r = jtag_ops_flush(o)) < 0)
+            return r;
+        uint32_t len = JTAG_OPS_BITS - o->nbits;
+        if (len > clocks)
+            len = clocks;
+        o->nbits += len;
+        clocks -= len;
+    }
+    return walk(o, end);
+}
+
+void jtag_ops_init(jtag_ops_t *o, const xvc_backend_t *lower)
+{
+    memset(o, 0, sizeof(*o));
+    o->lower = lower;
+    o->state = JTAG_TEST_LOGIC_RESET;
+}
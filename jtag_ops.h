@@ -0,0 +1,67 @@
+#ifndef __JTAG_OPS_H__
+#define __JTAG_OPS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "jtag_tap.h"
+#include "xvc_backend.h"
+#include "xvc_server.h"
+
+// TAP level operations for on-device users (SVF playback, polling, debug
+// ports): goto-state, scan-IR/DR and runtest on top of a shift backend, on
+// the board pio_xfer_backend (pio_xfer_rw and the short path). The ops only
+// append TMS/TDI bits to a pending vector, walks between states come from a
+// precomputed shortest path table and moves to the state the TAP is already
+// in are dropped, so a sequence of ops goes to the engine as one shift on
+// flush or when the vector is full. TDO of the scans is only valid after
+// jtag_ops_flush() returned 0.
+
+#define JTAG_OPS_BITS (XVC_VECTOR_WORDS * 32) // pending bits per engine run
+#define JTAG_OPS_MAX_CAPTURES 16              // scans with tdo per engine run
+#define JTAG_OPS_MIN_IDLE 64                  // longer runtests use the idle op
+
+// shortest TMS walk from one state to another, tms bit i is clocked i-th
+typedef struct jtag_path
+{
+    uint8_t len; // 0..8
+    uint8_t tms;
+} jtag_path_t;
+
+extern const jtag_path_t jtag_paths[JTAG_STATE_COUNT][JTAG_STATE_COUNT];
+
+typedef struct jtag_capture
+{
+    uint32_t *dst;
+    int dst_off, src_off, n;
+} jtag_capture_t;
+
+typedef struct jtag_ops
+{
+    const xvc_backend_t *lower;
+    jtag_state_t state; // after the pending bits
+    bool known;         // false until the first reset and after a failed run
+    int nbits;
+    int ncap;
+    jtag_capture_t cap[JTAG_OPS_MAX_CAPTURES];
+    uint32_t tms[XVC_VECTOR_WORDS], tdi[XVC_VECTOR_WORDS], tdo[XVC_VECTOR_WORDS];
+    // ops queued, engine runs, bits clocked, transitions not clocked
+    uint32_t ops, runs, bits, skipped;
+} jtag_ops_t;
+
+void jtag_ops_init(jtag_ops_t *o, const xvc_backend_t *lower);
+// five TMS=1 clocks, skipped when the TAP is known to be in Test-Logic-Reset
+int jtag_ops_reset(jtag_ops_t *o);
+// walks to s, resets first when the state is not known
+int jtag_ops_goto(jtag_ops_t *o, jtag_state_t s);
+// shifts n bits through IR/DR and leaves the TAP in end; tdi NULL shifts
+// zeros, tdo NULL drops the captured bits. end Shift-IR/DR stays in the shift
+// state so the next scan continues it
+int jtag_ops_scan_ir(jtag_ops_t *o, const uint32_t *tdi, uint32_t *tdo, int n, jtag_state_t end);
+int jtag_ops_scan_dr(jtag_ops_t *o, const uint32_t *tdi, uint32_t *tdo, int n, jtag_state_t end);
+// clocks in Run-Test/Idle, then walks to end
+int jtag_ops_runtest(jtag_ops_t *o, uint32_t clocks, jtag_state_t end);
+// runs the pending bits, 0 or < 0 when the backend failed (state unknown)
+int jtag_ops_flush(jtag_ops_t *o);
+
+#endif
@@ -0,0 +1,31 @@
+#include "jtag_tap.h"
+
+const uint8_t jtag_next_state[JTAG_STATE_COUNT][2] = {
+    //                    tms=0              tms=1
+    [JTAG_TEST_LOGIC_RESET] = {JTAG_RUN_TEST_IDLE, JTAG_TEST_LOGIC_RESET},
+    [JTAG_RUN_TEST_IDLE] = {JTAG_RUN_TEST_IDLE, JTAG_SELECT_DR_SCAN},
+    [JTAG_SELECT_DR_SCAN] = {JTAG_CAPTURE_DR, JTAG_SELECT_IR_SCAN},
+    [JTAG_CAPTURE_DR] = {JTAG_SHIFT_DR, JTAG_EXIT1_DR},
+    [JTAG_SHIFT_DR] = {JTAG_SHIFT_DR, JTAG_EXIT1_DR},
+    [JTAG_EXIT1_DR] = {JTAG_PAUSE_DR, JTAG_UPDATE_DR},
+    [JTAG_PAUSE_DR] = {JTAG_PAUSE_DR, JTAG_EXIT2_DR},
+    [JTAG_EXIT2_DR] = {JTAG_SHIFT_DR, JTAG_UPDATE_DR},
+    [JTAG_UPDATE_DR] = {JTAG_RUN_TEST_IDLE, JTAG_SELECT_DR_SCAN},
+    [JTAG_SELECT_IR_SCAN] = {JTAG_CAPTURE_IR, JTAG_TEST_LOGIC_RESET},
+    [JTAG_CAPTURE_IR] = {JTAG_SHIFT_IR, JTAG_EXIT1_IR},
+    [JTAG_SHIFT_IR] = {JTAG_SHIFT_IR, JTAG_EXIT1_IR},
+    [JTAG_EXIT1_IR] = {JTAG_PAUSE_IR, JTAG_UPDATE_IR},
+    [JTAG_PAUSE_IR] = {JTAG_PAUSE_IR, JTAG_EXIT2_IR},
+    [JTAG_EXIT2_IR] = {JTAG_SHIFT_IR, JTAG_UPDATE_IR},
+    [JTAG_UPDATE_IR] = {JTAG_RUN_TEST_IDLE, JTAG_SELECT_DR_SCAN},
+};
+
+static const char *const state_name[JTAG_STATE_COUNT] = {
+    "RESET", "IDLE", "DRSELECT", "DRCAPTURE", "DRSHIFT", "DREXIT1", "DRPAUSE", "DREXIT2",
+    "DRUPDATE", "IRSELECT", "IRCAPTURE", "IRSHIFT", "IREXIT1", "IRPAUSE", "IREXIT2", "IRUPDATE",
+};
+
+const char *jtag_state_name(jtag_state_t s)
+{
+    return s < JTAG_STATE_COUNT ? state_name[s] : "?";
+}
@@ -0,0 +1,38 @@
+#ifndef __JTAG_TAP_H__
+#define __JTAG_TAP_H__
+
+#include <stdint.h>
+
+// IEEE 1149.1 TAP controller states
+typedef enum jtag_state
+{
+    JTAG_TEST_LOGIC_RESET,
+    JTAG_RUN_TEST_IDLE,
+    JTAG_SELECT_DR_SCAN,
+    JTAG_CAPTURE_DR,
+    JTAG_SHIFT_DR,
+    JTAG_EXIT1_DR,
+    JTAG_PAUSE_DR,
+    JTAG_EXIT2_DR,
+    JTAG_UPDATE_DR,
+    JTAG_SELECT_IR_SCAN,
+    JTAG_CAPTURE_IR,
+    JTAG_SHIFT_IR,
+    JTAG_EXIT1_IR,
+    JTAG_PAUSE_IR,
+    JTAG_EXIT2_IR,
+    JTAG_UPDATE_IR,
+    JTAG_STATE_COUNT
+} jtag_state_t;
+
+extern const uint8_t jtag_next_state[JTAG_STATE_COUNT][2];
+
+// state after one TCK rising edge with the given TMS
+static inline jtag_state_t jtag_step(jtag_state_t s, int tms)
+{
+    return (jtag_state_t)jtag_next_state[s][tms & 1];
+}
+
+const char *jtag_state_name(jtag_state_t s);
+
+#endif
@@ -7,15 +7,67 @@
 // This example uses a common include to avoid repetition
 #include "lwipopts_examples_common.h"
 
+// Checksums on the M0+ come from xvc_chksum.c. LWIP_CHKSUM_ALGORITHM 3 stays
+// so lwip_standard_chksum() is still built as the reference for XVC_UBENCH.
+// With XVC_RX_COPY the usb driver verifies the TCP checksum of received
+// frames while it copies them (xvc_frame_copy), and lwIP does not check it
+// again there.
+unsigned short xvc_chksum(const void *data, int len);
+unsigned short xvc_chksum_copy(void *dst, const void *src, int len);
+#define LWIP_CHKSUM xvc_chksum
+#define LWIP_CHECKSUM_ON_COPY 1
+#define LWIP_CHKSUM_COPY(dst, src, len) xvc_chksum_copy(dst, src, len)
+#define LWIP_CHECKSUM_CTRL_PER_NETIF 1
+// received frames are PBUF_REF pbufs on the usb buffer (main.c, rx_ref)
+#define LWIP_SUPPORT_CUSTOM_PBUF 1
+
 #if !NO_SYS
 #define TCPIP_THREAD_STACKSIZE 1024
 #define DEFAULT_THREAD_STACKSIZE 1024
 #define DEFAULT_RAW_RECVMBOX_SIZE 8
 #define TCPIP_MBOX_SIZE 8
 #define LWIP_TIMEVAL_PRIVATE 0
+// xvc listener, metrics listener and scrape, XVC_MAX_CONN clients
+#define MEMP_NUM_NETCONN 8
+#define MEMP_NUM_TCP_PCB 8
+
+// client replies are written with a timeout (XVC_SEND_TIMEOUT_MS)
+#define LWIP_SO_SNDTIMEO 1
+// shift: replies go to tcp_write() without a copy (main.c, tx_lent): a
+// single pbuf per segment would copy them, and a close that cannot wait for
+// their ACK resets the connection
+#undef LWIP_NETIF_TX_SINGLE_PBUF
+#define LWIP_NETIF_TX_SINGLE_PBUF 0
+#define LWIP_SO_LINGER 1
 
 // not necessary, can be done either way
 #define LWIP_TCPIP_CORE_LOCKING_INPUT 1
+
+// Receive credits: a client may have at most TCP_WND bytes unread and the
+// window only reopens as the xvc server reads, which it does no faster than
+// the shift engine frees its vector buffers. Every unread segment holds a
+// PBUF_POOL buffer, so the windows of all clients have to fit the pool with
+// XVC_RX_SPARE_PBUFS left for ACKs, ARP and DHCP. Frames that still find the
+// pool empty wait in the USB endpoint (main.c) instead of being dropped.
+// Without XVC_RX_COPY an unread segment holds the usb receive buffer instead
+// and the endpoint NAKs until it is read; the pool only backs the rare copy
+// and this window does not limit anything, one unread segment stops all
+// traffic, every client, metrics and DHCP included.
+// A pbuf that lwIP keeps past delivery would pin the one usb buffer while the
+// endpoint is not renewed: an out of order segment waiting for the missing
+// one, or the first fragment of a datagram waiting for the rest, neither of
+// which could arrive. Without XVC_RX_COPY lwIP keeps neither.
+#if !XVC_RX_COPY
+#undef TCP_QUEUE_OOSEQ
+#define TCP_QUEUE_OOSEQ 0
+#undef IP_REASSEMBLY
+#define IP_REASSEMBLY 0
+#endif
+#define XVC_RX_CLIENTS 2 // XVC_MAX_CONN
+#define XVC_RX_SPARE_PBUFS 4
+#define XVC_RX_SEG 1460 // tcp payload of a full ethernet frame
+#undef TCP_WND
+#define TCP_WND (((PBUF_POOL_SIZE - XVC_RX_SPARE_PBUFS) / XVC_RX_CLIENTS) * XVC_RX_SEG)
 #endif
 
 #endif
@@ -36,10 +36,12 @@
 #define LWIP_NETIF_LINK_CALLBACK    1
 #define LWIP_NETIF_HOSTNAME         1
 #define LWIP_NETCONN                0
-#define MEM_STATS                   0
+// exported by the metrics endpoint (metrics.c)
+#define LWIP_STATS                  1
+#define MEM_STATS                   1
 #define SYS_STATS                   0
-#define MEMP_STATS                  0
-#define LINK_STATS                  0
+#define MEMP_STATS                  1
+#define LINK_STATS                  1
 // #define ETH_PAD_SIZE                2
 #define LWIP_CHKSUM_ALGORITHM       3
 #define LWIP_DHCP                   1
@@ -56,13 +58,15 @@
 
 #ifndef NDEBUG
 #define LWIP_DEBUG                  1
-#define LWIP_STATS                  1
 #define LWIP_STATS_DISPLAY          1
 #endif
 #if !defined LWIP_DBG_MIN_LEVEL || defined __DOXYGEN__
 #define LWIP_DBG_MIN_LEVEL              LWIP_DBG_LEVEL_ALL
 #endif
 
+// every category prints through a blocking uart printf on the request
+// path, only turn them on with XVC_LWIP_TRACE when chasing a stack problem
+#if XVC_LWIP_TRACE
 #define ETHARP_DEBUG                LWIP_DBG_ON
 #define NETIF_DEBUG                 LWIP_DBG_ON
 #define PBUF_DEBUG                  LWIP_DBG_ON
@@ -91,5 +95,6 @@
 #define PPP_DEBUG                   LWIP_DBG_ON
 #define SLIP_DEBUG                  LWIP_DBG_ON
 #define DHCP_DEBUG                  LWIP_DBG_ON
+#endif
 
 #endif /* __LWIPOPTS_H__ */
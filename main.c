@@ -34,13 +34,27 @@
 
 #include "bsp/board.h"
 #include "tusb.h"
+#include "device/usbd_pvt.h"
 #include "usb_descriptors.h"
 
 #include "lwip/netif.h"
 #include "lwip/ip4_addr.h"
+#include "lwip/tcpip.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/priv/sockets_priv.h"
 #include "lwip/apps/lwiperf.h"
 
 #include "pio_xfer.h"
+#include "xvc_server.h"
+#include "tap_track.h"
+#include "tdi_rle.h"
+#include "rec_flash.h"
+#include "xvc_dispatch.h"
+#include "xvc_stats.h"
+#include "xvc_chksum.h"
+#include "metrics.h"
+#include "dlog.h"
 #if TU_CHECK_MCU(ESP32S2) || TU_CHECK_MCU(ESP32S3)
 // ESP-IDF need "freertos/" prefix in include path.
 // CFG_TUSB_OS_INC_PATH should be defined accordingly.
@@ -85,14 +99,25 @@ TimerHandle_t blinky_tm;
 #endif
 
 StackType_t usb_device_stack[USBD_STACK_SIZE];
-StaticTask_t usb_device_taskdef;
+TaskHandle_t usb_device_taskdef;
 
-// static task for hid
-#define HID_STACK_SZIE configMINIMAL_STACK_SIZE
-TaskHandle_t hid_stack[HID_STACK_SZIE];
+// the xvc server task runs every layer: calibration, tap_track, tdi_rle, the
+// recorder, the metrics page and with XVC_UBENCH printf("%f"); in words, 6 KB
+// from the heap
+#define HID_STACK_SZIE (6 * configMINIMAL_STACK_SIZE)
 TaskHandle_t hid_taskdef;
 TaskHandle_t traffic_taskdef;
 
+// core assignment with XVC_SMP: usb + tcpip on core0, xvc server + shifts on core1.
+// the two sides only talk through lwIP mailboxes (tcpip_input, netconn recv/send)
+#if FREE_RTOS_KERNEL_SMP && configNUM_CORES > 1
+#define XVC_SMP_PINNED 1
+#define XVC_CORE_NET_MASK (1u << 0)
+#define XVC_CORE_JTAG_MASK (1u << 1)
+#else
+#define XVC_SMP_PINNED 0
+#endif
+
 void led_blinky_cb(TimerHandle_t xTimer);
 void usb_device_task(void *param);
 void hid_task(void *params);
@@ -102,6 +127,21 @@ static struct netif netif_data;
 
 /* shared between tud_network_recv_cb() and service_traffic() */
 static struct pbuf *received_frame;
+/* its tcp checksum failed, it is only freed */
+static bool received_bad;
+/* a frame the pbuf pool had no room for stays in the usb buffer: the endpoint
+   is only renewed once it is copied, so the host sees NAKs and not a drop */
+static const uint8_t *held_src;
+static uint16_t held_size;
+#if !XVC_RX_COPY
+/* lwIP reads the frame straight out of the usb receive buffer through this
+   PBUF_REF pbuf; the endpoint is renewed when lwIP frees it. rx_ref_stale:
+   the driver re-armed the buffer itself (usb reset) before that */
+static struct pbuf_custom rx_ref;
+static bool rx_ref_busy, rx_ref_stale;
+/* freed on the usb task itself, service_traffic() renews */
+static volatile bool rx_ref_freed;
+#endif
 
 /* this is used by this code, ./class/net/net_driver.c, and usb_descriptors.c */
 /* ideally speaking, this should be generated from the hardware's unique ID (if available) */
@@ -140,7 +180,7 @@ static err_t linkoutput_fn(struct netif *netif, struct pbuf *p)
     /* if TinyUSB isn't ready, we must signal back to lwip that there is nothing we can do */
     if (!tud_ready())
     {
-      printf("%s,%d\n",__func__,__LINE__);
+      DLOG0(LINK_NOT_READY);
       return ERR_USE;
     }
       
@@ -172,6 +212,10 @@ static err_t netif_init_cb(struct netif *netif)
   netif->name[1] = 'X';
   netif->linkoutput = linkoutput_fn;
   netif->output = output_fn;
+#if XVC_RX_COPY
+  /* take_frame() verifies tcp checksums while copying */
+  NETIF_SET_CHECKSUM_CTRL(netif, NETIF_CHECKSUM_ENABLE_ALL & ~NETIF_CHECKSUM_CHECK_TCP);
+#endif
   return ERR_OK;
 }
 
@@ -187,25 +231,84 @@ bool dns_query_proc(const char *name, ip_addr_t *addr)
   return false;
 }
 
+static bool take_frame(const uint8_t *src, uint16_t size)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, size, PBUF_POOL);
+  if (!p)
+    return false;
+  /* pbuf_alloc() has already initialized struct; all we need to do is copy the data */
+#if XVC_RX_COPY
+  /* the copy checksums tcp segments */
+  received_bad = xvc_frame_copy(p->payload, src, size) < 0;
+  if (received_bad)
+    xvc_counters.usb_rx_csum_drops++;
+#else
+  memcpy(p->payload, src, size);
+#endif
+  xvc_counters.usb_rx_copy_bytes += size;
+  /* store away the pointer for service_traffic() to later handle */
+  received_frame = p;
+  return true;
+}
+
+#if !XVC_RX_COPY
+/* runs in the usb task, tud_network_recv_renew() is not safe anywhere else */
+static void rx_ref_renew(void *param)
+{
+  (void)param;
+  if (!rx_ref_stale)
+    tud_network_recv_renew();
+  rx_ref_busy = rx_ref_stale = false;
+}
+
+/* the last reference went away. With LWIP_TCPIP_CORE_LOCKING_INPUT, ARP,
+   ICMP, DHCP and pure ACK frames are freed inside tcpip_input() on the usb
+   task, which would block forever posting to its own full queue; only the
+   tcpip thread and the xvc task go through the queue */
+static void rx_ref_free(struct pbuf *p)
+{
+  (void)p;
+  if (xTaskGetCurrentTaskHandle() == usb_device_taskdef)
+    rx_ref_freed = true;
+  else
+    usbd_defer_func(rx_ref_renew, NULL, false);
+}
+
+static bool ref_frame(const uint8_t *src, uint16_t size)
+{
+  if (rx_ref_busy)
+    return false;
+  rx_ref_busy = true;
+  rx_ref.custom_free_function = rx_ref_free;
+  received_frame = pbuf_alloced_custom(PBUF_RAW, size, PBUF_REF, &rx_ref, (void *)src, size);
+  return true;
+}
+#endif
+
 bool tud_network_recv_cb(const uint8_t *src, uint16_t size)
 {
   /* this shouldn't happen, but if we get another packet before
   parsing the previous, we must signal our inability to accept it */
-  if (received_frame)
+  if (received_frame || held_src)
   {
-    printf("recv bug in usb recv_cb");
+    DLOG0(USB_RECV_BUSY);
+    xvc_counters.usb_rx_drops++;
     return false;
   }
 
   if (size)
   {
-    struct pbuf *p = pbuf_alloc(PBUF_RAW, size, PBUF_POOL);
-    if (p)
+    xvc_counters.usb_rx_frames++;
+#if !XVC_RX_COPY
+    /* only after a usb reset can the last one still be in lwIP, copy then */
+    if (ref_frame(src, size))
+      return true;
+#endif
+    if (!take_frame(src, size))
     {
-      /* pbuf_alloc() has already initialized struct; all we need to do is copy the data */
-      memcpy(p->payload, src, size);
-      /* store away the pointer for service_traffic() to later handle */
-      received_frame = p;
+      held_src = src;
+      held_size = size;
+      xvc_counters.usb_rx_held++;
     }
   }
 
@@ -217,32 +320,68 @@ uint16_t tud_network_xmit_cb(uint8_t *dst, void *ref, uint16_t arg)
   struct pbuf *p = (struct pbuf *)ref;
 
   (void)arg; /* unused for this example */
-
-  return pbuf_copy_partial(p, dst, p->tot_len, 0);
+  xvc_counters.usb_tx_frames++;
+
+  /* the driver sends from one buffer after its RNDIS header, the chain is
+     gathered into it; a lent TDO reply is a segment of its own in the chain,
+     this is its only copy */
+  uint16_t n = pbuf_copy_partial(p, dst, p->tot_len, 0);
+  xvc_counters.usb_tx_copy_bytes += n;
+  return n;
 }
 
 void service_traffic(void)
 {
+#if !XVC_RX_COPY
+  if (rx_ref_freed)
+  {
+    rx_ref_freed = false;
+    rx_ref_renew(NULL);
+  }
+#endif
+  /* retry a held frame, the xvc server frees pool buffers as it reads */
+  if (held_src && take_frame(held_src, held_size))
+    held_src = NULL;
   /* handle any packet received by tud_network_recv_cb() */
   if (received_frame)
   {
-    ethernet_input(received_frame, &netif_data);
-    pbuf_free(received_frame);
+    /* netif input is tcpip_input: the frame is queued to the tcpip thread
+       and lwIP owns it from here on, unless the mailbox is full */
+    struct pbuf *p = received_frame;
     received_frame = NULL;
+    if (received_bad || netif_data.input(p, &netif_data) != ERR_OK)
+      pbuf_free(p);
+#if !XVC_RX_COPY
+    /* a zero-copy frame renews the endpoint when it is freed, right away
+       when that was just now in tcpip_input() */
+    if (p == &rx_ref.pbuf)
+    {
+      if (rx_ref_freed)
+      {
+        rx_ref_freed = false;
+        rx_ref_renew(NULL);
+      }
+      return;
+    }
+#endif
     tud_network_recv_renew();
   }
-
-  sys_check_timeouts();
 }
 
 void tud_network_init_cb(void)
 {
+#if !XVC_RX_COPY
+  /* the driver re-arms its buffer now, lwIP may still hold the old frame */
+  if (rx_ref_busy)
+    rx_ref_stale = true;
+#endif
   /* if the network is re-initializing and we have a leftover packet, we must do a cleanup */
   if (received_frame)
   {
     pbuf_free(received_frame);
     received_frame = NULL;
   }
+  held_src = NULL;
 }
 
 //--------------------------------------------------------------------+
@@ -263,6 +402,7 @@ while (1)
 int main(void)
 {
   board_init();
+  dlog_init();
   printf("app start\n");
 
   // soft timer for blinky
@@ -271,10 +411,17 @@ int main(void)
   TaskHandle_t rtos_task;
   TaskHandle_t rtos_task1;
   // Create a task for tinyusb device stack
+#if XVC_SMP_PINNED
+  (void)xTaskCreateAffinitySet(usb_device_task, "usbd", USBD_STACK_SIZE, NULL, 0, XVC_CORE_NET_MASK, &usb_device_taskdef);
+  //  Create HID task, it runs the xvc server and every shift on core1
+  (void)xTaskCreateAffinitySet(hid_task, "hid", HID_STACK_SZIE, NULL, 5, XVC_CORE_JTAG_MASK, &hid_taskdef);
+#else
   (void)xTaskCreate(usb_device_task, "usbd", USBD_STACK_SIZE, NULL, 0, &usb_device_taskdef);
   // xTaskCreate()
   //  Create HID task
   (void)xTaskCreate(hid_task, "hid", HID_STACK_SZIE, NULL, 5, &hid_taskdef);
+#endif
+  dlog_start();
   //(void)xTaskCreate(traffic_task, "traffic_task", HID_STACK_SZIE, NULL, 0, &traffic_taskdef);
   // skip starting scheduler (and return) for ESP32-S2 or ESP32-S3
 #if !(TU_CHECK_MCU(ESP32S2) || TU_CHECK_MCU(ESP32S3))
@@ -293,6 +440,7 @@ void app_main(void)
 #include <fcntl.h>
 #include <sys/types.h>
 #include "lwip/sockets.h"
+#include "lwip/errno.h"
 int tcp_app()
 {
   int i;
@@ -334,163 +482,236 @@ int tcp_app_runloop()
 {
   return 0;
 }
-static int sread(int fd, void *target, int len)
+static int sock_read(void *ctx, void *buf, int len)
 {
-  unsigned char *t = target;
-  while (len)
+  int r = recv((int)(intptr_t)ctx, buf, len, MSG_DONTWAIT);
+  if (r > 0)
   {
-    int r = read(fd, t, len);
-    if (r <= 0)
-    {
-      return r;
-    }
-      
-    t += r;
-    len -= r;
+    xvc_counters.sock_rx_bytes += r;
+    return r;
   }
-  return 1;
+  if (r < 0 && (errno == EWOULDBLOCK || errno == EAGAIN))
+    return 0;
+  return -1;
 }
-unsigned char buffer[2048 + 1024], result[1024 + 1024];
-int handle_data(int fd, void *ptr)
+
+static int sock_write(void *ctx, const void *buf, int len)
+{
+  int r = write((int)(intptr_t)ctx, buf, len);
+  if (r > 0)
+  {
+    xvc_counters.sock_tx_bytes += r;
+    xvc_counters.sock_tx_copy_bytes += r;
+  }
+  return r;
+}
+
+/* a client that stops reading would otherwise block this task, and every
+   other client with it, in write() */
+static int set_send_timeout(int fd)
+{
+  struct timeval tv = {XVC_SEND_TIMEOUT_MS / 1000, XVC_SEND_TIMEOUT_MS % 1000 * 1000};
+  return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static xvc_server_t xvc;
+static tap_track_t tap;
+static tdi_rle_t rle;
+static xvc_rec_t rec;
+static xvc_dispatch_t dispatch;
+
+/* per client; a reply finds them all busy only while the peer delays its
+   ACKs, and is copied then */
+#define XVC_TX_LENT 4
+
+/* a shift: reply shifted in place and queued without a copy, busy until the
+   peer acknowledged the sequence number after its last byte */
+typedef struct tx_lent
 {
+  uint32_t tdo[XVC_VECTOR_WORDS];
+  u32_t end;
+  bool busy;
+} tx_lent_t;
 
-  const char xvcInfo[] = "xvcServer_v1.0:2048\n";
-  do
+static struct
+{
+  int fd; // -1: free
+  bool closing;       // out of the select set, waits for tx_reap() to reach 0
+  TickType_t closing_until;
+  xvc_conn_t parser;
+  tx_lent_t tx[XVC_TX_LENT];
+} conns[XVC_MAX_CONN];
+// the receive window is split between this many clients (lwipopts.h)
+_Static_assert(XVC_RX_CLIENTS == XVC_MAX_CONN, "TCP_WND has to be resized");
+
+static int conn_find(int fd)
+{
+  for (int i = 0; i < XVC_MAX_CONN; i++)
+    if (conns[i].fd == fd)
+      return i;
+  return -1;
+}
+
+/* The socket API copies every write into the stack, so a shift: reply is
+   queued with tcp_write() on the pcb under the socket instead, without
+   TCP_WRITE_FLAG_COPY, and the tdo buffer is the segment payload until it is
+   acknowledged. The netconn owns the pcb's sent callback, so the buffers are
+   reaped by pcb->lastack. Without the pcb lwIP has freed the segments too.
+   The socket to pcb path and those pcb fields are lwIP internals, checked
+   against 2.1 and 2.2. */
+#if LWIP_VERSION_MAJOR != 2 || LWIP_VERSION_MINOR < 1 || LWIP_VERSION_MINOR > 2
+#error "lent tx buffers read lwIP internals, check sock_pcb() and tx_reap() for this version"
+#endif
+static struct tcp_pcb *sock_pcb(int fd)
+{
+  struct lwip_sock *sock = lwip_socket_dbg_get_socket(fd);
+  return sock && sock->conn ? sock->conn->pcb.tcp : NULL;
+}
+
+/* frees the acknowledged buffers of conns[i], returns how many stay busy */
+static int tx_reap(int i)
+{
+  int busy = 0;
+  LOCK_TCPIP_CORE();
+  struct tcp_pcb *pcb = sock_pcb(conns[i].fd);
+  for (int k = 0; k < XVC_TX_LENT; k++)
   {
-    char cmd[16];
-    
-    memset(cmd, 0, 16);
-    if (sread(fd, cmd, 2) != 1)
-      return 1;
-    if (memcmp(cmd, "ge", 2) == 0)
-    {
-      if (sread(fd, cmd, 6) != 1)
-        return 1;
-      memcpy(result, xvcInfo, strlen(xvcInfo));
-      if (write(fd, result, strlen(xvcInfo)) != strlen(xvcInfo))
-      {
-        perror("write");
-        return 1;
-      }
-      break;
-    }
-    else if (memcmp(cmd, "se", 2) == 0)
-    {
-      if (sread(fd, cmd, 9) != 1)
-        return 1;
-      memcpy(result, cmd + 5, 4);
-      if (write(fd, result, 4) != 4)
-      {
-        perror("write");
-        return 1;
-      }
-      break;
-    }
-    else if (memcmp(cmd, "sh", 2) == 0)
-    {
-      if (sread(fd, cmd, 4) != 1)
-        return 1;
-    }
-    else
-    {
-      fprintf(stderr, "invalid cmd '%x %x'\n", cmd[0], cmd[1]);
-      return 1;
-    }
-    // shift 4 word | len 4 word | nr_bytes * 2 tms and tdi
-    int len;
-    if (sread(fd, &len, 4) != 1)
-    {
-      fprintf(stderr, "reading length failed\n");
-      return 1;
-    }
+    tx_lent_t *b = &conns[i].tx[k];
+    if (b->busy && (!pcb || TCP_SEQ_GEQ(pcb->lastack, b->end)))
+      b->busy = false;
+    busy += b->busy;
+  }
+  UNLOCK_TCPIP_CORE();
+  return busy;
+}
 
-    int nr_bytes = (len + 7) / 8;
-    if (nr_bytes * 2 > sizeof(buffer))
-    {
-      fprintf(stderr, "buffer size exceeded\n");
-      return 1;
-    }
-    if (sread(fd, buffer, nr_bytes * 2) != 1)
+static void *sock_lend(void *ctx, int len)
+{
+  int i = conn_find((int)(intptr_t)ctx);
+  (void)len; /* every buffer holds the largest reply */
+  if (i < 0)
+    return NULL;
+  tx_reap(i);
+  for (int k = 0; k < XVC_TX_LENT; k++)
+    if (!conns[i].tx[k].busy)
+      return conns[i].tx[k].tdo;
+  xvc_counters.tx_lent_busy++;
+  return NULL;
+}
+
+static int sock_send_lent(void *ctx, const void *buf, int len)
+{
+  int fd = (int)(intptr_t)ctx, i = conn_find(fd);
+  tx_lent_t *b = NULL;
+  err_t err = ERR_CONN;
+
+  for (int k = 0; i >= 0 && k < XVC_TX_LENT; k++)
+    if (conns[i].tx[k].tdo == buf)
+      b = &conns[i].tx[k];
+  LOCK_TCPIP_CORE();
+  struct tcp_pcb *pcb = b ? sock_pcb(fd) : NULL;
+  if (pcb)
+    err = tcp_write(pcb, buf, len, 0);
+  if (err == ERR_OK)
+  {
+    b->end = pcb->snd_lbb;
+    b->busy = true;
+    tcp_output(pcb);
+  }
+  UNLOCK_TCPIP_CORE();
+  if (err != ERR_OK)
+  {
+    /* the send queue is full: copy it, write() waits for room */
+    return sock_write(ctx, buf, len);
+  }
+  xvc_counters.sock_tx_bytes += len;
+  return len;
+}
+
+static int conn_open(int fd)
+{
+  for (int i = 0; i < XVC_MAX_CONN; i++)
+  {
+    if (conns[i].fd < 0)
     {
-      fprintf(stderr, "reading data failed\n");
-      return 1;
+      conns[i].fd = fd;
+      xvc_conn_init(&conns[i].parser);
+      return 0;
     }
-    //memset(result, 0, nr_bytes);
-    int bytesLeft = nr_bytes;
-    int bitsLeft = len;
-    int byteIndex = 0;
-    int tdi, tms, tdo;
-    unsigned char *tms_ptr = malloc(nr_bytes + 8);
-    memcpy(tms_ptr, buffer + nr_bytes, nr_bytes);
-    unsigned char *tdi_ptr = malloc(nr_bytes + 8);
-    memcpy(tdi_ptr, buffer, nr_bytes);
-    pio_xfer_rw(tms_ptr, buffer, &result[byteIndex], len);
-    free(tms_ptr);
-    free(tdi_ptr);
-#if 0
-    while (bytesLeft > 0)
-    {
-      tms = 0;
-      tdi = 0;
-      tdo = 0;
-      if (bytesLeft >= 4)
-      {
-        memcpy(&tms, &buffer[byteIndex], 4);
-        memcpy(&tdi, &buffer[byteIndex + nr_bytes], 4);
-        /*
-        ptr->length_offset = 32;
-        dsb(st);
-        ptr->tms_offset = tms;
-        dsb(st);
-        ptr->tdi_offset = tdi;
-        dsb(st);
-        ptr->ctrl_offset = 0x01;
-
-        while (ptr->ctrl_offset)
-        {
-        }
+  }
+  return -1;
+}
 
-        tdo = ptr->tdo_offset;
-        */
-            memcpy(&result[byteIndex], &tdo, 4);
+static void conn_free(int i)
+{
+  for (int k = 0; k < XVC_TX_LENT; k++)
+    conns[i].tx[k].busy = false;
+  close(conns[i].fd);
+  conns[i].fd = -1;
+  conns[i].closing = false;
+}
 
-        bytesLeft -= 4;
-        bitsLeft -= 32;
-        byteIndex += 4;
-      }
-      else
-      {
-        memcpy(&tms, &buffer[byteIndex], bytesLeft);
-        memcpy(&tdi, &buffer[byteIndex + nr_bytes], bytesLeft);
-        /*
-                ptr->length_offset = bitsLeft;
-                dsb(st);
-                ptr->tms_offset = tms;
-                dsb(st);
-                ptr->tdi_offset = tdi;
-                dsb(st);
-                ptr->ctrl_offset = 0x01;
-                while (ptr->ctrl_offset)
-                {
-                }
-
-                tdo = ptr->tdo_offset;
-        */
-        memcpy(&result[byteIndex], &tdo, bytesLeft);
-
-        break;
-      }
+/* closes fd, the caller takes it out of the select set. A closed pcb goes on
+   sending what is queued, from the lent buffers, so a client with replies
+   unacknowledged keeps its slot and socket until conns_reap() sees them
+   acknowledged, or resets it after XVC_SEND_TIMEOUT_MS; the other clients
+   are served meanwhile */
+static void conn_close(int fd)
+{
+  int i = conn_find(fd);
+  if (i < 0)
+  {
+    close(fd);
+    return;
+  }
+  if (!tx_reap(i))
+  {
+    conn_free(i);
+    return;
+  }
+  conns[i].closing = true;
+  conns[i].closing_until = xTaskGetTickCount() + pdMS_TO_TICKS(XVC_SEND_TIMEOUT_MS);
+}
+
+/* from the select loop, which wakes at least every 100 ms */
+static void conns_reap(void)
+{
+  for (int i = 0; i < XVC_MAX_CONN; i++)
+  {
+    if (!conns[i].closing)
+      continue;
+    if (!tx_reap(i))
+    {
+      conn_free(i);
     }
-#endif
-    if (write(fd, result, nr_bytes) != nr_bytes)
+    else if ((int32_t)(xTaskGetTickCount() - conns[i].closing_until) >= 0)
     {
-      perror("write");
-      return 1;
+      /* a reset frees the queued segments */
+      struct linger l = {1, 0};
+      DLOG1(HID_TX_RESET, conns[i].fd);
+      setsockopt(conns[i].fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+      conn_free(i);
     }
+  }
+}
 
-  } while (1);
-  /* Note: Need to fix JTAG state updates, until then no exit is allowed */
-  return 0;
+// calib: clocks the chain with TMS=1, which leaves it in Test-Logic-Reset
+static int calibrate(char *text, int size)
+{
+  xvc_dispatch_calibrate(&dispatch);
+  tap_track_reset(&tap);
+  return xvc_dispatch_report(&dispatch, text, size);
+}
+
+int handle_data(int fd, void *ptr)
+{
+  (void)ptr;
+  xvc_transport_t t = {
+      .ctx = (void *)(intptr_t)fd, .read = sock_read, .write = sock_write, .lend = sock_lend, .send_lent = sock_send_lent};
+  for (int i = 0; i < XVC_MAX_CONN; i++)
+    if (conns[i].fd == fd)
+      return xvc_server_feed(&xvc, &conns[i].parser, &t);
+  return 1;
 }
 
 /* This function initializes this lwIP test. When NO_SYS=1, this is done in
@@ -510,6 +731,10 @@ test_init(void *arg)
   /* init randomizer again (seed per thread) */
   srand((unsigned int)time(NULL));
   printf("task %s,%d\n", __func__, __LINE__);
+#if XVC_SMP_PINNED
+  /* we are running on the tcpip thread here, keep it next to the usb task */
+  vTaskCoreAffinitySet(NULL, XVC_CORE_NET_MASK);
+#endif
   /* init network interfaces */
   // test_netif_init();
 
@@ -518,7 +743,7 @@ test_init(void *arg)
   netif->hwaddr_len = sizeof(tud_network_mac_address);
   memcpy(netif->hwaddr, tud_network_mac_address, sizeof(tud_network_mac_address));
   netif->hwaddr[5] ^= 0x01;
-  netif = netif_add(netif, &ipaddr, &netmask, &gateway, NULL, netif_init_cb, ip_input);
+  netif = netif_add(netif, &ipaddr, &netmask, &gateway, NULL, netif_init_cb, tcpip_input);
   netif_set_default(netif);
 
   /* init apps */
@@ -544,8 +769,8 @@ void usb_device_task(void *param)
   // RTOS forever loop
   while (1)
   {
-    // tinyusb device task
-    tud_task();
+    // tinyusb device task, polls every ms while a frame waits for the pool
+    tud_task_ext(held_src ? 1 : UINT32_MAX, false);
     service_traffic();
     
   }
@@ -626,7 +851,7 @@ void hid_task(void *param)
     return 1;
   }
   printf("%s,%d\n", __func__, __LINE__);
-  if (listen(s, 1) < 0)
+  if (listen(s, XVC_MAX_CONN) < 0)
   {
     perror("listen");
     return 1;
@@ -637,41 +862,93 @@ void hid_task(void *param)
   FD_ZERO(&conn);
   FD_SET(s, &conn);
   maxfd = s;
+  for (i = 0; i < XVC_MAX_CONN; i++)
+    conns[i].fd = -1;
+  int m = metrics_listen();
+  int scrape = -1; /* accepted metrics connection, answered once its request is in */
+  if (m < 0)
+  {
+    perror("metrics");
+  }
+  else
+  {
+    FD_SET(m, &conn);
+    if (m > maxfd)
+      maxfd = m;
+  }
   pio_xfer_init();
-  printf("%s,%d\n", __func__, __LINE__);
+#ifdef XVC_UBENCH
+  xvc_chksum_ubench();
+#endif
+  xvc_dispatch_init(&dispatch);
+  xvc_dispatch_add(&dispatch, "pio", &pio_queue_backend, 0);
+  xvc_dispatch_add(&dispatch, "pio_short", &pio_short_backend, 32);
+  xvc_dispatch_add(&dispatch, "pio_dma", &pio_chain_backend, 0);
+  xvc_dispatch_calibrate(&dispatch);
+  metrics_set_dispatch(&dispatch);
+  tdi_rle_init(&rle, &dispatch.backend);
+  tap_track_init(&tap, &rle.backend);
+  tap_track_reset(&tap);
+  metrics_add_cache("tap_track", &tap.cache);
+  metrics_add_cache("tdi_rle", &rle.cache);
+  xvc_rec_init(&rec, &tap.backend, &rec_flash_store);
+  rec.track = &tap;
+  xvc_server_init(&xvc, &rec.backend);
+  xvc.rec = &rec;
+  xvc.calibrate = calibrate;
+  xvc.crc32 = pio_xfer_crc32;
+  bool btn_down = false;
+  xvc_stats_reset();
+  DLOG1(HID_LISTEN, port);
   while (1)
   {
     fd_set read = conn, except = conn;
     int fd;
-    printf("%s,%d\n",__func__,__LINE__);
-    if (select(maxfd + 1, &read, 0, &except, 0) < 0)
+    // wake up now and then to look at the button
+    struct timeval tv = {0, 100000};
+    int ready = select(maxfd + 1, &read, 0, &except, &tv);
+    if (ready < 0)
     {
-      printf("%s,%d\n",__func__,__LINE__);
-      perror("select");
+      DLOG1(HID_SELECT_ERR, errno);
       break;
     }
+    /* only wakeups with work are logged, the idle timeouts would flood the ring */
+    if (ready > 0)
+      DLOG2(HID_SELECT, maxfd, ready);
+#if configNUM_CORES == 1
+    // BOOTSEL is read with XIP off, with SMP only the play: command replays
+    bool btn = board_button_read();
+    if (btn && !btn_down)
+    {
+      uint32_t bad; // the result goes to the log
+      xvc_rec_replay(&rec, &bad);
+    }
+    btn_down = btn;
+#endif
+    conns_reap();
     for (fd = 0; fd <= maxfd; ++fd)
     {
-      printf("%s,%d\n",__func__,__LINE__);
       if (FD_ISSET(fd, &read))
       {
         if (fd == s)
         {
-          printf("%s,%d\n",__func__,__LINE__);
           int newfd;
           socklen_t nsize = sizeof(address);
 
           newfd = accept(s, (struct sockaddr *)&address, &nsize);
 
-          //               if (verbose)
-          printf("connection accepted - fd %d\n", newfd);
           if (newfd < 0)
           {
-            perror("accept");
+            DLOG1(HID_ACCEPT_ERR, errno);
+          }
+          else if (conn_open(newfd) < 0)
+          {
+            DLOG1(HID_BUSY, newfd);
+            close(newfd);
           }
           else
           {
-            printf("setting TCP_NODELAY to 1\n");
+            DLOG1(HID_ACCEPT, newfd);
             int flag = 1;
             int optResult = setsockopt(newfd,
                                        IPPROTO_TCP,
@@ -679,7 +956,9 @@ void hid_task(void *param)
                                        (char *)&flag,
                                        sizeof(int));
             if (optResult < 0)
-              perror("TCP_NODELAY error");
+              DLOG1(HID_NODELAY_ERR, newfd);
+            if (set_send_timeout(newfd) < 0)
+              DLOG1(HID_SNDTIMEO_ERR, newfd);
             if (newfd > maxfd)
             {
               maxfd = newfd;
@@ -687,17 +966,49 @@ void hid_task(void *param)
             FD_SET(newfd, &conn);
           }
         }
+        else if (fd == m)
+        {
+          socklen_t nsize = sizeof(address);
+          int newfd = accept(m, (struct sockaddr *)&address, &nsize);
+          if (newfd >= 0)
+          {
+            /* one scrape at a time, a newer one replaces it */
+            if (scrape >= 0)
+            {
+              close(scrape);
+              FD_CLR(scrape, &conn);
+            }
+            set_send_timeout(newfd);
+            metrics_begin();
+            scrape = newfd;
+            FD_SET(scrape, &conn);
+            if (scrape > maxfd)
+              maxfd = scrape;
+          }
+        }
+        else if (fd == scrape)
+        {
+          if (metrics_serve(fd))
+          {
+            close(fd);
+            FD_CLR(fd, &conn);
+            scrape = -1;
+          }
+        }
         else if (handle_data(fd, NULL))
         {
-          close(fd);
+          DLOG1(HID_CLOSE, fd);
+          conn_close(fd);
           FD_CLR(fd, &conn);
         }
       }
       else if (FD_ISSET(fd, &except))
       {
-        printf("%s,%d\n",__func__,__LINE__);
-        close(fd);
+        DLOG1(HID_EXCEPT, fd);
+        conn_close(fd);
         FD_CLR(fd, &conn);
+        if (fd == scrape)
+          scrape = -1;
         if (fd == s)
           break;
       }
@@ -0,0 +1,218 @@
+#include "metrics.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/sockets.h"
+#include "lwip/errno.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "xvc_stats.h"
+#include "xvc_dispatch.h"
+#include "shift_cache.h"
+
+static const char *const memp_name[] = {
+#define LWIP_MEMPOOL(name, num, size, desc) #name,
+#include "lwip/priv/memp_std.h"
+};
+
+// previous scrape, rates are computed between two scrapes
+static struct
+{
+    uint64_t t;
+    uint64_t bits;
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+} last;
+
+static const xvc_dispatch_t *dispatch;
+static struct
+{
+    const char *layer;
+    const shift_cache_t *cache;
+} caches[METRICS_MAX_CACHES];
+static int ncaches;
+
+void metrics_set_dispatch(const xvc_dispatch_t *d)
+{
+    dispatch = d;
+}
+
+void metrics_add_cache(const char *layer, const shift_cache_t *c)
+{
+    if (ncaches == METRICS_MAX_CACHES)
+        return;
+    caches[ncaches].layer = layer;
+    caches[ncaches++].cache = c;
+}
+
+int metrics_listen(void)
+{
+    struct sockaddr_in address;
+    int i = 1;
+    int s = lwip_socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0)
+        return -1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &i, sizeof i);
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(METRICS_PORT);
+    address.sin_family = AF_INET;
+    if (bind(s, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(s, 1) < 0)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+int metrics_format(char *buf, int size)
+{
+    const xvc_counters_t *c = &xvc_counters;
+    uint64_t now = time_us_64();
+    uint64_t dt = now - last.t;
+    int n = 0;
+
+#define EMIT(...)                                          \
+    do                                                     \
+    {                                                      \
+        if (n < size)                                      \
+            n += snprintf(buf + n, size - n, __VA_ARGS__); \
+    } while (0)
+
+    EMIT("uptime_us %llu\n", (unsigned long long)now);
+    EMIT("heap_free_bytes %u\n", (unsigned)xPortGetFreeHeapSize());
+    EMIT("heap_min_free_bytes %u\n", (unsigned)xPortGetMinimumEverFreeHeapSize());
+#if LWIP_STATS
+#if MEM_STATS
+    EMIT("lwip_mem_used %u\nlwip_mem_max %u\nlwip_mem_err %u\n",
+         (unsigned)lwip_stats.mem.used, (unsigned)lwip_stats.mem.max, (unsigned)lwip_stats.mem.err);
+#endif
+#if MEMP_STATS
+    for (int i = 0; i < MEMP_MAX; i++)
+    {
+        const struct stats_mem *m = lwip_stats.memp[i];
+        EMIT("lwip_memp{pool=\"%s\"} used %u max %u avail %u err %u\n", memp_name[i],
+             (unsigned)m->used, (unsigned)m->max, (unsigned)m->avail, (unsigned)m->err);
+    }
+#endif
+#if LINK_STATS
+    EMIT("lwip_link_xmit %u\nlwip_link_recv %u\nlwip_link_drop %u\nlwip_link_memerr %u\n",
+         (unsigned)lwip_stats.link.xmit, (unsigned)lwip_stats.link.recv,
+         (unsigned)lwip_stats.link.drop, (unsigned)lwip_stats.link.memerr);
+#endif
+#if TCP_STATS
+    EMIT("lwip_tcp_drop %u\nlwip_tcp_rexmit %u\nlwip_tcp_memerr %u\n",
+         (unsigned)lwip_stats.tcp.drop, (unsigned)lwip_stats.tcp.rexmit, (unsigned)lwip_stats.tcp.memerr);
+#endif
+#endif
+    EMIT("usb_rx_frames %lu\nusb_rx_drops %lu\nusb_rx_held %lu\nusb_tx_frames %lu\n", (unsigned long)c->usb_rx_frames,
+         (unsigned long)c->usb_rx_drops, (unsigned long)c->usb_rx_held, (unsigned long)c->usb_tx_frames);
+    EMIT("usb_rx_csum_drops %lu\n", (unsigned long)c->usb_rx_csum_drops);
+    EMIT("usb_rx_copy_bytes %llu\nxvc_sock_rx_bytes %llu\n", (unsigned long long)c->usb_rx_copy_bytes,
+         (unsigned long long)c->sock_rx_bytes);
+    // copies of a received byte on its way from the usb buffer into the shift vectors
+    if (c->sock_rx_bytes)
+    {
+        uint64_t cpb = (c->usb_rx_copy_bytes + c->sock_rx_bytes) * 100 / c->sock_rx_bytes;
+        EMIT("xvc_rx_copies_per_byte %lu.%02lu\n", (unsigned long)(cpb / 100), (unsigned long)(cpb % 100));
+    }
+    EMIT("usb_tx_copy_bytes %llu\nxvc_sock_tx_bytes %llu\n", (unsigned long long)c->usb_tx_copy_bytes,
+         (unsigned long long)c->sock_tx_bytes);
+    EMIT("xvc_sock_tx_copy_bytes %llu\nxvc_tx_lent_busy %lu\n", (unsigned long long)c->sock_tx_copy_bytes,
+         (unsigned long)c->tx_lent_busy);
+    // and of a tdo byte from the shift buffer to the usb buffer, lent replies skip the first
+    if (c->sock_tx_bytes)
+    {
+        uint64_t cpb = (c->sock_tx_copy_bytes + c->usb_tx_copy_bytes) * 100 / c->sock_tx_bytes;
+        EMIT("xvc_tx_copies_per_byte %lu.%02lu\n", (unsigned long)(cpb / 100), (unsigned long)(cpb % 100));
+    }
+    EMIT("tcp_wnd_bytes %u\n", (unsigned)TCP_WND);
+    EMIT("xvc_shifts %lu\nxvc_shift_bits %llu\nxvc_rx_bytes %llu\nxvc_tx_bytes %llu\n",
+         (unsigned long)c->shifts, (unsigned long long)c->shift_bits,
+         (unsigned long long)c->rx_bytes, (unsigned long long)c->tx_bytes);
+    EMIT("xvc_z_shifts %lu\nxvc_z_raw_bytes %llu\nxvc_z_wire_bytes %llu\n", (unsigned long)c->z_shifts,
+         (unsigned long long)c->z_raw_bytes, (unsigned long long)c->z_wire_bytes);
+    // what shiftz: saves on the wire, raw over coded bytes
+    if (c->z_wire_bytes)
+    {
+        uint64_t ratio = c->z_raw_bytes * 100 / c->z_wire_bytes;
+        EMIT("xvc_z_ratio %lu.%02lu\n", (unsigned long)(ratio / 100), (unsigned long)(ratio % 100));
+    }
+    EMIT("xvc_verify_shifts %lu\nxvc_verify_fails %lu\nxvc_crc_shifts %lu\nxvc_check_tdo_bytes %llu\n",
+         (unsigned long)c->verify_shifts, (unsigned long)c->verify_fails, (unsigned long)c->crc_shifts,
+         (unsigned long long)c->check_tdo_bytes);
+    EMIT("xvc_idle_runs %lu\nxvc_idle_bits %llu\n", (unsigned long)c->idle_runs, (unsigned long long)c->idle_bits);
+    EMIT("xvc_rle_runs %lu\nxvc_rle_bits %llu\nxvc_rle_fifo_words_saved %llu\n", (unsigned long)c->rle_runs,
+         (unsigned long long)c->rle_bits, (unsigned long long)c->rle_words_saved);
+    EMIT("xvc_shift_timeouts %lu\n", (unsigned long)c->shift_timeouts);
+    EMIT("xvc_irq_shifts %lu\nxvc_pio_irqs %lu\n", (unsigned long)c->irq_shifts, (unsigned long)c->pio_irqs);
+#if configGENERATE_RUN_TIME_STATS
+    // cpu time per task, the idle tasks show what the shifts leave free
+    static TaskStatus_t tasks[METRICS_MAX_TASKS];
+    uint32_t total;
+    UBaseType_t nt = uxTaskGetSystemState(tasks, METRICS_MAX_TASKS, &total);
+    for (UBaseType_t i = 0; i < nt; i++)
+        EMIT("task_run_us{task=\"%s\"} %lu\n", tasks[i].pcTaskName, (unsigned long)tasks[i].ulRunTimeCounter);
+    EMIT("task_run_total_us %lu\n", (unsigned long)total);
+#endif
+    if (dt)
+    {
+        EMIT("xvc_bits_per_second %llu\n", (c->shift_bits - last.bits) * 1000000u / dt);
+        EMIT("xvc_bytes_per_second %llu\n",
+             (c->rx_bytes + c->tx_bytes - last.rx_bytes - last.tx_bytes) * 1000000u / dt);
+    }
+    // achieved tck: bits over the time spent inside pio_xfer_rw
+    if (c->shift_us)
+        EMIT("xvc_tck_hz %llu\n", c->shift_bits * 1000000u / c->shift_us);
+#undef EMIT
+    if (dispatch && n < size)
+        n += xvc_dispatch_report(dispatch, buf + n, size - n);
+    for (int i = 0; i < ncaches && n < size; i++)
+        n += shift_cache_report(caches[i].cache, caches[i].layer, buf + n, size - n);
+
+    last.t = now;
+    last.bits = c->shift_bits;
+    last.rx_bytes = c->rx_bytes;
+    last.tx_bytes = c->tx_bytes;
+    return n < size ? n : size - 1;
+}
+
+// the last four bytes of the request so far
+static uint32_t req_tail;
+
+void metrics_begin(void)
+{
+    req_tail = 0;
+}
+
+// The request is read to its end before the reply: closing a socket with
+// unread bytes, or with the request still on its way, resets the connection
+// and the scraper sees that instead of the page.
+int metrics_serve(int fd)
+{
+    static char text[8192];
+    static const char header[] = "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n";
+    char req[64];
+    bool done = false;
+    int r;
+
+    // whatever path was asked for, every one returns the metrics
+    while ((r = recv(fd, req, sizeof(req), MSG_DONTWAIT)) > 0)
+    {
+        for (int i = 0; i < r; i++)
+        {
+            req_tail = req_tail << 8 | (uint8_t)req[i];
+            done |= req_tail == 0x0d0a0d0a || (req_tail & 0xffff) == 0x0a0a;
+        }
+    }
+    if (r < 0 && errno != EWOULDBLOCK && errno != EAGAIN)
+        return -1;
+    if (!done && r != 0)
+        return 0;
+    int n = metrics_format(text, sizeof(text));
+    if (write(fd, header, sizeof(header) - 1) < 0 || write(fd, text, n) < 0)
+        perror("metrics write");
+    return 1;
+}
@@ -0,0 +1,24 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+// plain text metrics on http://192.168.7.1/ (or nc 192.168.7.1 80 and an empty line)
+#define METRICS_PORT 80
+#define METRICS_MAX_TASKS 12 // task_run_us lines
+
+int metrics_listen(void);
+// a scrape was accepted, its request starts now
+void metrics_begin(void);
+// reads what arrived of the request and answers once its blank line is in or
+// the client closed its side: 1 once answered, 0 to wait for more and -1
+// when the connection failed; the caller closes it on anything but 0
+int metrics_serve(int fd);
+int metrics_format(char *buf, int size);
+struct xvc_dispatch;
+// adds the shift path thresholds and usage to the page
+void metrics_set_dispatch(const struct xvc_dispatch *d);
+#define METRICS_MAX_CACHES 2
+struct shift_cache;
+// adds the hits and the time saved of a layer's shift cache to the page
+void metrics_add_cache(const char *layer, const struct shift_cache *c);
+
+#endif
@@ -1,19 +1,64 @@
 #include "pio_xfer.h"
 #include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#include "dlog.h"
+#include "xvc_stats.h"
+
 pio_xfer_inst_t xfer;
+static xfer_queue_t queue;
+static uint32_t bit_ns; // one TCK, 14 PIO cycles
 #define TEST_TMS
 
+// A shift of a multiple of 32 bits has its last rx word autopushed by the
+// final `in pins`, 10 PIO cycles before that bit's rising and falling TCK
+// edges; with pad bits the push comes from loopblock, after them. Before the
+// tdata state machines are stopped, reprogrammed or their pins forced, wait
+// until both stall on the pull at header with TCK low. Stopped ones (after
+// init or a reset) have nothing in flight, a stuck one is left to the
+// caller's deadline after one TCK.
+static void tdata_settle(void)
+{
+    PIO pio = xfer.pio;
+    const uint sms[2] = {xfer.sm_data, xfer.sm_tms};
+    uint64_t deadline = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        uint sm = sms[i];
+        uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+        if (!(pio->ctrl & (1u << (PIO_CTRL_SM_ENABLE_LSB + sm))))
+            continue;
+        pio->fdebug = stall; // write 1 to clear, set again while the pull stalls
+        while (pio_sm_get_pc(pio, sm) != xfer.offset[sm] + tdata_offset_header || !(pio->fdebug & stall))
+        {
+            if (!deadline)
+                deadline = time_us_64() + bit_ns / 1000 + 2;
+            else if (time_us_64() > deadline)
+                break;
+        }
+    }
+}
+
 void pio_tms_set_period(PIO pio, uint sm, uint32_t num)
 {
     pio_sm_set_enabled(pio, sm, false);
-    pio_sm_put_blocking(pio, sm, (num % 32 == 0 ? 0 : (32 - num % 32)) << 16 | (num - 1));
+    // settled, the header pull has emptied the tx fifo
+    pio->txf[sm] = (num % 32 == 0 ? 0 : (32 - num % 32)) << 16 | (num - 1);
     pio_sm_exec(pio, sm, pio_encode_pull(false, false));
     pio_sm_exec(pio, sm, pio_encode_out(pio_y, 16));
     pio_sm_exec(pio, sm, pio_encode_out(pio_x, 16));
+    // tdata_settle() left the state machine waiting in header
+    pio_sm_exec(pio, sm, pio_encode_jmp(xfer.offset[sm]));
 }
-int write_read_nbits(PIO pio, uint sm_data, uint sm_tms, uint32_t *tx_data, uint32_t *tx_tms, uint32_t *rx, uint16_t nbits)
+int write_read_nbits(PIO pio, uint sm_data, uint sm_tms, const uint32_t *tx_data, const uint32_t *tx_tms, uint32_t *rx, uint16_t nbits)
 {
     int i = 0;
+    tdata_settle();
     pio_tms_set_period(pio, sm_data, nbits);
 #ifdef TEST_TMS
     pio_tms_set_period(pio, sm_tms, nbits);
@@ -85,31 +130,686 @@ int write_read_nbits(PIO pio, uint sm_data, uint sm_tms, uint32_t *tx_data, uint
     return 0;
 }
 
-int pio_xfer_rw(uint32_t *tx_data, uint32_t *tx_tms, uint32_t *tdi, int nbits)
+// xfer_queue port on the two tdata state machines, a word goes to both tx
+// fifos at once and both rx fifos are drained (sm_tms pushes its dummy tdo)
+static void port_start(void *ctx, int nbits)
+{
+    (void)ctx;
+    tdata_settle();
+    pio_tms_set_period(xfer.pio, xfer.sm_data, nbits);
+    pio_tms_set_period(xfer.pio, xfer.sm_tms, nbits);
+    pio_enable_sm_mask_in_sync(xfer.pio, (1u << xfer.sm_data) | (1u << xfer.sm_tms));
+}
+
+static bool port_tx_full(void *ctx)
+{
+    (void)ctx;
+    return pio_sm_is_tx_fifo_full(xfer.pio, xfer.sm_data) || pio_sm_is_tx_fifo_full(xfer.pio, xfer.sm_tms);
+}
+
+static void port_put(void *ctx, uint32_t tms, uint32_t tdi)
+{
+    (void)ctx;
+    pio_sm_put(xfer.pio, xfer.sm_tms, tms);
+    pio_sm_put(xfer.pio, xfer.sm_data, tdi);
+}
+
+static bool port_rx_empty(void *ctx)
+{
+    (void)ctx;
+    return pio_sm_is_rx_fifo_empty(xfer.pio, xfer.sm_data) || pio_sm_is_rx_fifo_empty(xfer.pio, xfer.sm_tms);
+}
+
+static uint32_t port_get(void *ctx)
+{
+    (void)ctx;
+    (void)pio_sm_get(xfer.pio, xfer.sm_tms);
+    return pio_sm_get(xfer.pio, xfer.sm_data);
+}
+
+// Stall recovery: every shift gets twice its nominal time plus
+// PIO_XFER_SLACK_US. When that passes the four state machines are stopped,
+// emptied and sent back to the start of their programs with TCK low.
+uint32_t pio_xfer_timeout_us(uint32_t nbits)
+{
+    return (uint32_t)(2 * (uint64_t)nbits * bit_ns / 1000) + PIO_XFER_SLACK_US;
+}
+
+static void engine_reset(int nbits)
+{
+    PIO pio = xfer.pio;
+    uint32_t mask = (1u << xfer.sm_data) | (1u << xfer.sm_tms) | (1u << xfer.sm_idle) | (1u << xfer.sm_repeat);
+    pio_set_sm_mask_enabled(pio, mask, false);
+    for (uint sm = 0; sm < 4; sm++)
+    {
+        pio_sm_clear_fifos(pio, sm);
+        pio_sm_restart(pio, sm);
+        pio_sm_exec(pio, sm, pio_encode_jmp(xfer.offset[sm]));
+    }
+    pio_sm_set_pins_with_mask(pio, xfer.sm_data, 0, 1u << xfer.tck_pin);
+    // the counter programs wait on pull, the tdata ones are started per shift
+    pio_set_sm_mask_enabled(pio, (1u << xfer.sm_idle) | (1u << xfer.sm_repeat), true);
+    xvc_counters.shift_timeouts++;
+    DLOG1(PIO_TIMEOUT, nbits);
+}
+
+static void port_reset(void *ctx, int nbits)
+{
+    (void)ctx;
+    engine_reset(nbits);
+}
+
+// waits for a word from sm, the deadline is armed on the first empty look
+static bool get_until(PIO pio, uint sm, uint32_t *v, uint64_t *deadline, uint32_t timeout_us)
+{
+    while (pio_sm_is_rx_fifo_empty(pio, sm))
+    {
+        uint64_t now = time_us_64();
+        if (!*deadline)
+            *deadline = now + timeout_us;
+        else if (now > *deadline)
+            return false;
+    }
+    *v = pio->rxf[sm];
+    return true;
+}
+
+// no more words in flight than the rx fifo holds: neither state machine may
+// stall on a full rx fifo while the other keeps clocking
+static const xfer_port_t pio_port = {
+    .ctx = NULL,
+    .window = 4,
+    .start = port_start,
+    .tx_full = port_tx_full,
+    .put = port_put,
+    .rx_empty = port_rx_empty,
+    .get = port_get,
+    .reset = port_reset,
+};
+
+// Shifts of PIO_XFER_IRQ_BITS and more are serviced from the PIO0_IRQ_0
+// handler: sm_data's rx-not-empty and tx-not-full sources are armed for just
+// what the head request waits on and the issuing task sleeps on its
+// notification, so the usb and lwip tasks get the core meanwhile. While
+// irq_mode is set only the handler services the queue. Requests are started
+// by tasks alone: port_start() waits for the state machines to settle, and
+// the handler hands a request that is not started back to irq_waiter.
+static volatile bool irq_mode;
+static TaskHandle_t volatile irq_waiter;
+
+// returns false once the handler has nothing left to wait on
+static bool irq_arm(void)
+{
+    int want = xfer_queue_wants(&queue);
+    uint32_t src = 0;
+    if (want & XFER_WANT_RX)
+        src |= PIO_INTR_SM0_RXNEMPTY_BITS << xfer.sm_data;
+    if (want & XFER_WANT_TX)
+        src |= PIO_INTR_SM0_TXNFULL_BITS << xfer.sm_data;
+    xfer.pio->inte0 = src;
+    if (!src)
+        irq_mode = false;
+    return src != 0;
+}
+
+static void __isr pio_irq_handler(void)
+{
+    BaseType_t woken = pdFALSE;
+    xvc_counters.pio_irqs++;
+    xfer_queue_service_started(&queue);
+    if (!irq_arm() && irq_waiter && xfer_queue_wants(&queue))
+        vTaskNotifyGiveFromISR(irq_waiter, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// task side servicing, a no-op while the handler owns the queue
+static inline void service(void)
+{
+    if (!irq_mode)
+        xfer_queue_service(&queue);
+}
+
+// starts the head request on the task, the handler takes it from there
+static void irq_start(void)
+{
+    xfer_queue_service(&queue);
+    irq_mode = true;
+    irq_arm();
+}
+
+static int rw_irq(pio_xfer_req_t *req)
+{
+    TickType_t ticks = pdMS_TO_TICKS(req->timeout_us / 1000) + 2;
+    while (queue.count)
+        service();
+    req->done = pio_xfer_notify;
+    req->arg = xTaskGetCurrentTaskHandle();
+    irq_waiter = req->arg;
+    xfer_queue_submit(&queue, req);
+    irq_start();
+    xvc_counters.irq_shifts++;
+    while (req->status == XFER_PENDING)
+    {
+        bool woken = ulTaskNotifyTake(pdTRUE, ticks);
+        if (req->status != XFER_PENDING)
+            break;
+        if (!irq_mode)
+        {
+            // the handler left a request to start
+            irq_start();
+        }
+        else if (!woken)
+        {
+            // a stall raises no interrupt, the waiter has to notice it
+            xfer.pio->inte0 = 0;
+            irq_mode = false;
+            xfer_queue_abort(&queue);
+        }
+    }
+    irq_waiter = NULL;
+    return req->status;
+}
+
+int pio_xfer_submit(pio_xfer_req_t *req)
+{
+    return xfer_queue_submit(&queue, req);
+}
+
+bool pio_xfer_poll(pio_xfer_req_t *req)
+{
+    service();
+    return req->status != XFER_PENDING;
+}
+
+int pio_xfer_wait(pio_xfer_req_t *req)
+{
+    while (req->status == XFER_PENDING)
+        service();
+    return req->status;
+}
+
+void pio_xfer_notify(pio_xfer_req_t *req)
+{
+    BaseType_t woken = pdFALSE;
+    if (portCHECK_IF_IN_ISR())
+    {
+        vTaskNotifyGiveFromISR((TaskHandle_t)req->arg, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        xTaskNotifyGive((TaskHandle_t)req->arg);
+    }
+}
+
+int pio_xfer_rw(const uint32_t *tx_data, const uint32_t *tx_tms, uint32_t *tdi, int nbits)
 {
 #ifdef USE_PIO
-    return write_read_nbits(xfer.pio, xfer.sm_data, xfer.sm_tms, tx_data, tx_tms, tdi, nbits);
+    pio_xfer_req_t req = {.tms = tx_tms, .tdi = tx_data, .tdo = tdi, .nbits = nbits,
+                          .timeout_us = pio_xfer_timeout_us(nbits)};
+    if (nbits >= PIO_XFER_IRQ_BITS)
+        return rw_irq(&req);
+    while (pio_xfer_submit(&req) < 0)
+        service();
+    return pio_xfer_wait(&req);
 #else
     tdi = gpio_xfer(nbits, tx_tms);
     return 0;
 #endif
 }
+// clocks count TCKs with TMS held at tms, returns the TDO level or -1
+int pio_xfer_idle(int tms, uint32_t count)
+{
+    uint64_t deadline = 0;
+    uint32_t level;
+    // the counter programs borrow the tdata pins, finish queued shifts first
+    while (queue.count)
+        service();
+    tdata_settle();
+    // sm_tms owns the TMS pin, it is stopped between shifts and reprogrammed
+    // by the next write_read_nbits()
+    pio_sm_set_enabled(xfer.pio, xfer.sm_tms, false);
+    pio_sm_set_pins_with_mask(xfer.pio, xfer.sm_tms, (tms ? 1u : 0u) << xfer.tms_pin, 1u << xfer.tms_pin);
+    pio_sm_put_blocking(xfer.pio, xfer.sm_idle, count - 1);
+    if (!get_until(xfer.pio, xfer.sm_idle, &level, &deadline, pio_xfer_timeout_us(count)))
+    {
+        engine_reset(count);
+        return -1;
+    }
+    return level & 1;
+}
+
+// clocks count TCKs with TMS and TDI held, tdo gets one bit per clock
+int pio_xfer_repeat(int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    uint64_t deadline = 0;
+    uint32_t timeout_us = pio_xfer_timeout_us(count), tail;
+    while (queue.count)
+        service();
+    tdata_settle();
+    pio_sm_set_enabled(xfer.pio, xfer.sm_tms, false);
+    pio_sm_set_enabled(xfer.pio, xfer.sm_data, false);
+    pio_sm_set_pins_with_mask(xfer.pio, xfer.sm_tms, (tms ? 1u : 0u) << xfer.tms_pin, 1u << xfer.tms_pin);
+    pio_sm_set_pins_with_mask(xfer.pio, xfer.sm_data, (tdi ? 1u : 0u) << xfer.tdi_pin, 1u << xfer.tdi_pin);
+    pio_sm_put_blocking(xfer.pio, xfer.sm_repeat, count - 1);
+    for (uint32_t i = 0; i <= count / 32; i++)
+    {
+        if (!get_until(xfer.pio, xfer.sm_repeat, i < count / 32 ? &tdo[i] : &tail, &deadline, timeout_us))
+        {
+            engine_reset(count);
+            return -1;
+        }
+    }
+    if (count % 32)
+        tdo[count / 32] = tail >> (32 - count % 32);
+    return 0;
+}
+
+static int pio_backend_repeat(void *ctx, int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    (void)ctx;
+    return pio_xfer_repeat(tms, tdi, tdo, count);
+}
+
+static int pio_backend_idle(void *ctx, int tms, uint32_t count)
+{
+    (void)ctx;
+    return pio_xfer_idle(tms, count);
+}
+
+// Shifts of 1 to 32 bits (TAP moves, IR scans) skip the queue: the period
+// word comes from a table built at compile time, both state machines are
+// reloaded with one mask write each way and exactly one word goes in and
+// one comes out.
+#define SHORT_PERIOD(n) ((((n) == 32 ? 0u : 32u - (n)) << 16) | ((n) - 1u))
+#define SHORT_PERIOD4(n) SHORT_PERIOD(n), SHORT_PERIOD(n + 1), SHORT_PERIOD(n + 2), SHORT_PERIOD(n + 3)
+static const uint32_t short_period[33] = {
+    0, SHORT_PERIOD4(1), SHORT_PERIOD4(5), SHORT_PERIOD4(9), SHORT_PERIOD4(13),
+    SHORT_PERIOD4(17), SHORT_PERIOD4(21), SHORT_PERIOD4(25), SHORT_PERIOD4(29),
+};
+
+static inline void short_load(PIO pio, uint sm, uint32_t period)
+{
+    pio->txf[sm] = period;
+    pio_sm_exec(pio, sm, pio_encode_pull(false, false));
+    pio_sm_exec(pio, sm, pio_encode_out(pio_y, 16));
+    pio_sm_exec(pio, sm, pio_encode_out(pio_x, 16));
+    pio_sm_exec(pio, sm, pio_encode_jmp(xfer.offset[sm]));
+}
+
+int pio_xfer_short(uint32_t tms, uint32_t tdi, uint32_t *tdo, int nbits)
+{
+    PIO pio = xfer.pio;
+    uint64_t deadline = 0;
+    uint32_t dummy;
+    uint32_t mask = (1u << xfer.sm_data) | (1u << xfer.sm_tms);
+    tdata_settle();
+    pio_set_sm_mask_enabled(pio, mask, false);
+    short_load(pio, xfer.sm_tms, short_period[nbits]);
+    short_load(pio, xfer.sm_data, short_period[nbits]);
+    pio_enable_sm_mask_in_sync(pio, mask);
+    pio->txf[xfer.sm_tms] = tms;
+    pio->txf[xfer.sm_data] = tdi;
+    if (!get_until(pio, xfer.sm_tms, &dummy, &deadline, PIO_XFER_SHORT_TIMEOUT_US) ||
+        !get_until(pio, xfer.sm_data, tdo, &deadline, PIO_XFER_SHORT_TIMEOUT_US))
+    {
+        engine_reset(nbits);
+        return -1;
+    }
+    return 0;
+}
+
+static int pio_backend_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    (void)ctx;
+    // the fast path needs the state machines to itself
+    if (nbits <= 32 && !queue.count)
+        return pio_xfer_short(tms[0], tdi[0], tdo, nbits);
+    return pio_xfer_rw(tdi, tms, tdo, nbits);
+}
+
+#ifdef XVC_UBENCH
+static void pio_xfer_ubench_gap(void);
+// per shift latency of the general and the short path by length, on the uart
+static void pio_xfer_ubench(void)
+{
+    static const int lens[] = {1, 2, 5, 6, 8, 10, 16, 24, 32, 64, 256, 1024};
+    uint32_t tms[32] = {0}, tdi[32] = {0}, tdo[32];
+    const int rounds = 200;
+    printf("ubench: nbits  general us  short us\n");
+    for (unsigned i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+    {
+        int n = lens[i];
+        uint64_t t0 = time_us_64();
+        for (int r = 0; r < rounds; r++)
+            pio_xfer_rw(tdi, tms, tdo, n);
+        uint64_t t1 = time_us_64();
+        for (int r = 0; r < rounds && n <= 32; r++)
+            pio_xfer_short(tms[0], tdi[0], tdo, n);
+        uint64_t t2 = time_us_64();
+        printf("ubench: %5d  %10.2f  %8.2f\n", n, (t1 - t0) / (double)rounds,
+               n <= 32 ? (t2 - t1) / (double)rounds : 0.0);
+    }
+    pio_xfer_ubench_gap();
+}
+#endif
+
+const xvc_backend_t pio_xfer_backend = {
+    .ctx = NULL,
+    .shift = pio_backend_shift,
+    .set_tck = NULL,
+    .idle = pio_backend_idle,
+    .repeat = pio_backend_repeat,
+};
+
+// the two paths on their own, for xvc_dispatch.c to measure and pick from
+static int pio_queue_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    (void)ctx;
+    return pio_xfer_rw(tdi, tms, tdo, nbits);
+}
+
+static int pio_short_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    return queue.count ? pio_queue_shift(ctx, tms, tdi, tdo, nbits) : pio_xfer_short(tms[0], tdi[0], tdo, nbits);
+}
+
+const xvc_backend_t pio_queue_backend = {
+    .ctx = NULL,
+    .shift = pio_queue_shift,
+    .set_tck = NULL,
+    .idle = pio_backend_idle,
+    .repeat = pio_backend_repeat,
+};
+
+const xvc_backend_t pio_short_backend = {
+    .ctx = NULL,
+    .shift = pio_short_shift,
+    .set_tck = NULL,
+    .idle = pio_backend_idle,
+    .repeat = pio_backend_repeat,
+};
+
+// DMA chains (xfer_chain.h): per stream a control channel that feeds blocks
+// to a data channel, plus a sink for sm_tms's dummy tdo
+enum
+{
+    CHAIN_TMS,
+    CHAIN_TDI,
+    CHAIN_TDO,
+};
+
+static struct
+{
+    int ctrl[3], data[3], sink, crc;
+    dma_channel_config sink_cfg, crc_cfg;
+    xfer_chain_hw_t hw;
+    uint64_t deadline; // of the running chain
+    const xfer_chain_t *waiting; // chain a sleeping task waits for
+    TaskHandle_t waiter;
+} dma;
+static uint32_t sink_word;
+static xfer_chain_t one_chain;
+
+_Static_assert(sizeof(xfer_cb_t) == 16, "a control block fills the alias 0 registers");
+
+static void chain_irq_handler(void);
+
+static void chain_init(void)
+{
+    PIO pio = xfer.pio;
+    uint32_t ctrl[3];
+    for (int s = 0; s < 3; s++)
+    {
+        bool tx = s != CHAIN_TDO;
+        uint sm = s == CHAIN_TMS ? xfer.sm_tms : xfer.sm_data;
+        dma.ctrl[s] = dma_claim_unused_channel(true);
+        dma.data[s] = dma_claim_unused_channel(true);
+
+        dma_channel_config c = dma_channel_get_default_config(dma.data[s]);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, tx);
+        channel_config_set_write_increment(&c, !tx);
+        channel_config_set_dreq(&c, pio_get_dreq(pio, sm, tx));
+        channel_config_set_chain_to(&c, dma.ctrl[s]);
+        ctrl[s] = channel_config_get_ctrl_value(&c);
+
+        // 4 words per block into read, write, count and ctrl + trigger
+        dma_channel_config k = dma_channel_get_default_config(dma.ctrl[s]);
+        channel_config_set_transfer_data_size(&k, DMA_SIZE_32);
+        channel_config_set_read_increment(&k, true);
+        channel_config_set_write_increment(&k, true);
+        channel_config_set_ring(&k, true, 4);
+        dma_channel_configure(dma.ctrl[s], &k, &dma_hw->ch[dma.data[s]].read_addr, NULL, 4, false);
+    }
+    dma_channel_set_irq1_enabled(dma.ctrl[CHAIN_TDO], true);
+    irq_set_exclusive_handler(DMA_IRQ_1, chain_irq_handler);
+    irq_set_enabled(DMA_IRQ_1, true);
+    dma.sink = dma_claim_unused_channel(true);
+    dma.sink_cfg = dma_channel_get_default_config(dma.sink);
+    channel_config_set_transfer_data_size(&dma.sink_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&dma.sink_cfg, false);
+    channel_config_set_write_increment(&dma.sink_cfg, false);
+    channel_config_set_dreq(&dma.sink_cfg, pio_get_dreq(pio, xfer.sm_tms, false));
+    // memory to sink_word through the sniffer, see pio_xfer_crc32()
+    dma.crc = dma_claim_unused_channel(true);
+    dma.crc_cfg = dma_channel_get_default_config(dma.crc);
+    channel_config_set_transfer_data_size(&dma.crc_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&dma.crc_cfg, true);
+    channel_config_set_write_increment(&dma.crc_cfg, false);
+    channel_config_set_sniff_enable(&dma.crc_cfg, true);
+    dma.hw = (xfer_chain_hw_t){
+        .tms_fifo = &pio->txf[xfer.sm_tms],
+        .tdi_fifo = &pio->txf[xfer.sm_data],
+        .tdo_fifo = &pio->rxf[xfer.sm_data],
+        .tms_ctrl = ctrl[CHAIN_TMS],
+        .tdi_ctrl = ctrl[CHAIN_TDI],
+        .tdo_ctrl = ctrl[CHAIN_TDO],
+    };
+}
+
+const xfer_chain_hw_t *pio_xfer_chain_hw(void)
+{
+    return &dma.hw;
+}
+
+static void chain_abort(void)
+{
+    // EN is cleared first, an abort would otherwise trigger the chained
+    // channel (RP2040-E13)
+    for (int s = 0; s < 3; s++)
+    {
+        hw_clear_bits(&dma_hw->ch[dma.ctrl[s]].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+        hw_clear_bits(&dma_hw->ch[dma.data[s]].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+    }
+    hw_clear_bits(&dma_hw->ch[dma.sink].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+    for (int s = 0; s < 3; s++)
+    {
+        dma_channel_abort(dma.ctrl[s]);
+        dma_channel_abort(dma.data[s]);
+    }
+    dma_channel_abort(dma.sink);
+}
+
+// done once the tdo control channel has read the null block and the sink
+// has taken sm_tms's last word
+static bool chain_done(const xfer_chain_t *c)
+{
+    return dma_hw->ch[dma.ctrl[CHAIN_TDO]].read_addr == (uintptr_t)&c->tdo[c->shifts + 1] &&
+           !dma_channel_is_busy(dma.ctrl[CHAIN_TDO]) && !dma_channel_is_busy(dma.sink);
+}
+
+int pio_xfer_chain_start(const xfer_chain_t *c)
+{
+    PIO pio = xfer.pio;
+    uint32_t mask = (1u << xfer.sm_data) | (1u << xfer.sm_tms);
+    dma.deadline = time_us_64() + pio_xfer_timeout_us(c->bits + 32 * c->shifts);
+    if (!c->shifts)
+        return 0;
+    while (queue.count)
+        service();
+    tdata_settle();
+
+    // both tdata state machines wait for their first period word. They start
+    // each shift when their own period word lands, DMA keeps the skew to a
+    // few system clocks, far below one PIO cycle at PIO_CLKDIV
+    pio_set_sm_mask_enabled(pio, mask, false);
+    pio_sm_exec(pio, xfer.sm_tms, pio_encode_jmp(xfer.offset[xfer.sm_tms] + tdata_offset_header));
+    pio_sm_exec(pio, xfer.sm_data, pio_encode_jmp(xfer.offset[xfer.sm_data] + tdata_offset_header));
+    pio_enable_sm_mask_in_sync(pio, mask);
+
+    dma_channel_configure(dma.sink, &dma.sink_cfg, &sink_word, &pio->rxf[xfer.sm_tms], c->words, true);
+    dma_channel_set_read_addr(dma.ctrl[CHAIN_TDO], c->tdo, true);
+    dma_channel_set_read_addr(dma.ctrl[CHAIN_TMS], c->tms, true);
+    dma_channel_set_read_addr(dma.ctrl[CHAIN_TDI], c->tdi, true);
+    return 0;
+}
+
+int pio_xfer_chain_poll(const xfer_chain_t *c)
+{
+    if (!c->shifts || chain_done(c))
+        return 1;
+    if (time_us_64() <= dma.deadline)
+        return 0;
+    chain_abort();
+    engine_reset(c->bits);
+    return -1;
+}
+
+// the tdo control channel raises DMA_IRQ_1 after every block it writes, the
+// last one, the null block, wakes the waiter
+static void __isr chain_irq_handler(void)
+{
+    BaseType_t woken = pdFALSE;
+    dma_hw->ints1 = 1u << dma.ctrl[CHAIN_TDO];
+    xvc_counters.pio_irqs++;
+    if (dma.waiting && chain_done(dma.waiting))
+    {
+        dma.waiting = NULL;
+        vTaskNotifyGiveFromISR(dma.waiter, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+int pio_xfer_chain(const xfer_chain_t *c)
+{
+    int r;
+    if (c->bits < PIO_XFER_IRQ_BITS)
+    {
+        pio_xfer_chain_start(c);
+        while (!(r = pio_xfer_chain_poll(c)))
+            tight_loop_contents();
+        return r < 0 ? -1 : 0;
+    }
+    // long chains sleep like long queued shifts
+    dma.waiter = xTaskGetCurrentTaskHandle();
+    dma.waiting = c;
+    pio_xfer_chain_start(c);
+    xvc_counters.irq_shifts++;
+    while (!(r = pio_xfer_chain_poll(c)))
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(pio_xfer_timeout_us(c->bits) / 1000) + 2);
+    dma.waiting = NULL;
+    return r < 0 ? -1 : 0;
+}
+
+// every shift as a chain of one, a path for xvc_dispatch.c to weigh. Nothing
+// on the XVC path has two literal shifts to batch: tap_track and tdi_rle
+// only split a shift around idle and repeat runs, which clock on their own
+// state machines in between, and a connection reads the next shift into the
+// vectors of the last one after its reply went out
+static int pio_chain_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    (void)ctx;
+    xfer_chain_init(&one_chain, &dma.hw);
+    if (xfer_chain_add(&one_chain, tms, tdi, tdo, nbits) < 0)
+        return -1;
+    return pio_xfer_chain(&one_chain);
+}
+
+const xvc_backend_t pio_chain_backend = {
+    .ctx = NULL,
+    .shift = pio_chain_shift,
+    .set_tck = NULL,
+    .idle = pio_backend_idle,
+    .repeat = pio_backend_repeat,
+};
+
+// The tdo of one XVC shift may come from the idle, repeat, short, queued and
+// chained paths at once, so the sniffer runs one more DMA pass over the
+// finished words instead of watching the rx fifo: a word per system clock,
+// the CPU only starts it. CRC32R feeds each word LSB first, the bytes in
+// little endian order, and the reversed, inverted result is zlib's crc32().
+uint32_t pio_xfer_crc32(const uint32_t *words, int nwords)
+{
+    dma_sniffer_enable(dma.crc, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    hw_set_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    dma_hw->sniff_data = 0xffffffffu;
+    dma_channel_configure(dma.crc, &dma.crc_cfg, &sink_word, words, nwords, true);
+    dma_channel_wait_for_finish_blocking(dma.crc);
+    uint32_t crc = dma_hw->sniff_data;
+    dma_sniffer_disable();
+    return crc;
+}
+
+#ifdef XVC_UBENCH
+// TCKs lost between back to back shifts, XFER_CHAIN_MAX shifts queued one
+// after the other and as one DMA chain
+static void pio_xfer_ubench_gap(void)
+{
+    static const int lens[] = {32, 256, 1024};
+    static uint32_t tms[32], tdi[32], tdo[32];
+    const int k = XFER_CHAIN_MAX;
+    printf("ubench: nbits  queue gap tck  chain gap tck\n");
+    for (unsigned i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+    {
+        int n = lens[i];
+        xfer_chain_init(&one_chain, &dma.hw);
+        for (int s = 0; s < k; s++)
+            xfer_chain_add(&one_chain, tms, tdi, tdo, n);
+        uint64_t t0 = time_us_64();
+        for (int s = 0; s < k; s++)
+            pio_xfer_rw(tdi, tms, tdo, n);
+        uint64_t t1 = time_us_64();
+        pio_xfer_chain(&one_chain);
+        uint64_t t2 = time_us_64();
+        double busy_ns = (double)k * n * bit_ns;
+        printf("ubench: %5d  %13.1f  %13.1f\n", n, ((t1 - t0) * 1000.0 - busy_ns) / k / bit_ns,
+               ((t2 - t1) * 1000.0 - busy_ns) / k / bit_ns);
+    }
+}
+#endif
+
 int pio_xfer_init()
 {
 #ifdef USE_PIO
     xfer.pio = pio0;
     xfer.sm_data = 0;
     xfer.sm_tms = 1;
+    xfer.sm_idle = 2;
+    xfer.sm_repeat = 3;
     xfer.tck_pin = PIN_SCK;
     xfer.tdi_pin = PIN_TDI;
     xfer.tdo_pin = PIN_TDO;
     xfer.tms_pin = PIN_TMS;
+    xfer_queue_init(&queue, &pio_port);
+    irq_set_exclusive_handler(PIO0_IRQ_0, pio_irq_handler);
+    irq_set_enabled(PIO0_IRQ_0, true);
 
     float clkdiv = PIO_CLKDIV; // 1 MHz @ 125 clk_sys
+    bit_ns = (uint32_t)(14ull * PIO_CLKDIV * 1000000000ull / clock_get_hz(clk_sys));
     uint tdata_prog_offs = pio_add_program(xfer.pio, &tdata_program);
     pio_tdata_init(xfer.pio, xfer.sm_tms, tdata_prog_offs, clkdiv, 7, PIN_TMS, 8);
     // pio_tms_init(xfer.pio, xfer.sm_tms, tdata_prog_offs, clkdiv, PIN_TMS, PIN_SCK);
     pio_tdata_init(xfer.pio, xfer.sm_data, tdata_prog_offs, clkdiv, PIN_SCK, PIN_TDI, PIN_TDO);
+    uint tidle_prog_offs = pio_add_program(xfer.pio, &tidle_program);
+    pio_tidle_init(xfer.pio, xfer.sm_idle, tidle_prog_offs, clkdiv, PIN_SCK, PIN_TDO);
+    uint trepeat_prog_offs = pio_add_program(xfer.pio, &trepeat_program);
+    pio_trepeat_init(xfer.pio, xfer.sm_repeat, trepeat_prog_offs, clkdiv, PIN_SCK, PIN_TDO);
+    xfer.offset[xfer.sm_data] = tdata_prog_offs;
+    xfer.offset[xfer.sm_tms] = tdata_prog_offs;
+    xfer.offset[xfer.sm_idle] = tidle_prog_offs;
+    xfer.offset[xfer.sm_repeat] = trepeat_prog_offs;
+    chain_init();
 
     uint8_t *data = malloc(9);
     uint8_t *data1 = malloc(9);
@@ -125,6 +825,9 @@ int pio_xfer_init()
     } while (0);
     free(data1);
     free(data);
+#ifdef XVC_UBENCH
+    pio_xfer_ubench();
+#endif
     return 0;
 #else
     gpio_xfer_init();
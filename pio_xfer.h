@@ -6,6 +6,9 @@
 
 #include "pico/stdlib.h"
 #include "tdata.pio.h"
+#include "xvc_backend.h"
+#include "xfer_queue.h"
+#include "xfer_chain.h"
 
 
 #define PIN_SCK 2 // output
@@ -18,13 +21,60 @@ typedef struct pio_xfer_inst
     PIO pio;
     uint sm_data;
     uint sm_tms;
+    uint sm_idle;
+    uint sm_repeat;
     uint tck_pin;
     uint tms_pin;
     uint tdi_pin;
     uint tdo_pin;
+    uint offset[4]; // program start of each state machine, for the stall reset
 } pio_xfer_inst_t;
 
-int pio_xfer_rw(uint32_t *tx_data, uint32_t *tx_tms, uint32_t *tdi, int nbits);
+// a stalled shift fails with -1 once it overruns twice its nominal time plus
+// the slack; the short path waits one fixed slack for its single word
+#define PIO_XFER_SLACK_US 20000
+#define PIO_XFER_SHORT_TIMEOUT_US PIO_XFER_SLACK_US
+// pio_xfer_rw() sleeps and lets the fifo interrupt feed shifts this long
+#define PIO_XFER_IRQ_BITS 256
+
+// Asynchronous shifts: fill in tms, tdi, tdo, nbits and optionally done/arg,
+// submit, then poll or wait. Requests complete in submission order, at most
+// XFER_QUEUE_DEPTH are in flight and the buffers must stay valid until then.
+typedef xfer_req_t pio_xfer_req_t;
+// returns 0, or -1 when the queue is full
+int pio_xfer_submit(pio_xfer_req_t *req);
+// makes progress without blocking, returns true once req is done
+bool pio_xfer_poll(pio_xfer_req_t *req);
+// blocks until req is done, returns its status
+int pio_xfer_wait(pio_xfer_req_t *req);
+// done callback that gives the task notification of the task in req->arg
+void pio_xfer_notify(pio_xfer_req_t *req);
+
+// deadline for a request of nbits, for pio_xfer_req_t.timeout_us
+uint32_t pio_xfer_timeout_us(uint32_t nbits);
+// synchronous shift, submit + wait, 0 or -1 when the engine stalled
+int pio_xfer_rw(const uint32_t *tx_data, const uint32_t *tx_tms, uint32_t *tdi, int nbits);
+// 1 to 32 bit shift with nothing queued, 0 or -1 when the engine stalled
+int pio_xfer_short(uint32_t tms, uint32_t tdi, uint32_t *tdo, int nbits);
+// DMA chains built on pio_xfer_chain_hw() run back to back without the CPU.
+// start returns right away, nothing else may shift until poll says done:
+// 1 done, 0 running, -1 the engine stalled and was reset
+int pio_xfer_chain_start(const xfer_chain_t *c);
+int pio_xfer_chain_poll(const xfer_chain_t *c);
+// start + poll, 0 or -1
+int pio_xfer_chain(const xfer_chain_t *c);
+const xfer_chain_hw_t *pio_xfer_chain_hw(void);
+// CRC-32 of words by the DMA sniffer, the value of xvc_crc32() (xvc_verify.h)
+uint32_t pio_xfer_crc32(const uint32_t *words, int nwords);
+int pio_xfer_idle(int tms, uint32_t count);
+int pio_xfer_repeat(int tms, int tdi, uint32_t *tdo, uint32_t count);
+// short fast path up to 32 bits, the queue beyond
+extern const xvc_backend_t pio_xfer_backend;
+// only the queue, and only the fast path (1 to 32 bits)
+extern const xvc_backend_t pio_queue_backend;
+extern const xvc_backend_t pio_short_backend;
+// every shift as a DMA chain of one
+extern const xvc_backend_t pio_chain_backend;
 int pio_xfer_init(void);
 #define USE_PIO
 void gpio_xfer_init(void);
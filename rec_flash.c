@@ -0,0 +1,54 @@
+#include "rec_flash.h"
+
+#include "FreeRTOS.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+
+#include "dlog.h"
+
+#define REC_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - XVC_REC_SIZE)
+
+typedef struct flash_op
+{
+    uint32_t off, len;
+    const void *data; // NULL erases
+} flash_op_t;
+
+static void flash_op_run(void *param)
+{
+    const flash_op_t *op = param;
+    if (op->data)
+        flash_range_program(REC_FLASH_OFFSET + op->off, op->data, op->len);
+    else
+        flash_range_erase(REC_FLASH_OFFSET + op->off, op->len);
+}
+
+// XIP is off while the flash is erased or programmed. flash_safe_execute()
+// runs the op with interrupts off and, with SMP, the other core parked in
+// RAM by a task of the FreeRTOS port, which owns the SIO FIFO interrupt that
+// multicore_lockout would need
+static int flash_op(uint32_t off, uint32_t len, const void *data)
+{
+    flash_op_t op = {off, len, data};
+    int r = flash_safe_execute(flash_op_run, &op, REC_FLASH_TIMEOUT_MS);
+    if (r != PICO_OK)
+        DLOG2(REC_FLASH_ERR, off, r);
+    return r == PICO_OK ? 0 : -1;
+}
+
+static int rec_flash_erase(uint32_t off, uint32_t len)
+{
+    return flash_op(off, len, NULL);
+}
+
+static int rec_flash_program(uint32_t off, const void *data, uint32_t len)
+{
+    return flash_op(off, len, data);
+}
+
+const xvc_rec_store_t rec_flash_store = {
+    .base = (const uint8_t *)(XIP_BASE + REC_FLASH_OFFSET),
+    .size = XVC_REC_SIZE,
+    .erase = rec_flash_erase,
+    .program = rec_flash_program,
+};
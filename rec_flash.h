@@ -0,0 +1,16 @@
+#ifndef __REC_FLASH_H__
+#define __REC_FLASH_H__
+
+#include "xvc_rec.h"
+
+// the recorder store sits in the last XVC_REC_SIZE bytes of the flash
+#ifndef XVC_REC_SIZE
+#define XVC_REC_SIZE (1024 * 1024)
+#endif
+
+// how long an erase or program waits for the other core to park
+#define REC_FLASH_TIMEOUT_MS 100
+
+extern const xvc_rec_store_t rec_flash_store;
+
+#endif
@@ -0,0 +1,133 @@
+#include "shift_cache.h"
+#include <stdio.h>
+#include <string.h>
+
+static inline uint32_t rotl(uint32_t x, int r)
+{
+    return x << r | x >> (32 - r);
+}
+
+static inline uint32_t fmix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    return h ^ h >> 16;
+}
+
+void shift_cache_init(shift_cache_t *c)
+{
+    memset(c, 0, sizeof(*c));
+}
+
+void shift_cache_clear(shift_cache_t *c)
+{
+    memset(c->key, 0, sizeof(c->key));
+}
+
+// Two 32 bit lanes, the M0+ multiplies in one cycle but has no 64 bit
+// multiply. A step is a bijection of the lane for fixed input words and of
+// either word for a fixed lane, so vectors that differ in a single word never
+// share the first lane; the second takes the words in the other order.
+uint64_t shift_cache_key(const uint32_t *tms, const uint32_t *tdi, int nbits, uint32_t salt)
+{
+    int words = (nbits + 31) / 32;
+    uint32_t a = 0x9e3779b9u ^ salt, b = 0x7f4a7c15u ^ (uint32_t)nbits;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t m = w == words - 1 && nbits % 32 ? (1u << (nbits % 32)) - 1 : 0xffffffffu;
+        uint32_t t = tms[w] & m, d = tdi ? tdi[w] & m : 0;
+        a = (rotl(a ^ t, 13) + d) * 0x9e3779b1u;
+        b = (rotl(b ^ d, 17) + t) * 0x85ebca77u;
+    }
+    uint64_t key = (uint64_t)fmix(a ^ (uint32_t)nbits) << 32 | fmix(b ^ salt ^ a);
+    return key ? key : 1;
+}
+
+// the vectors of slot i against the shift, bits above nbits ignored
+static bool same(const shift_cache_t *c, int i, const uint32_t *tms, const uint32_t *tdi, int nbits)
+{
+    int words = (nbits + 31) / 32;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t m = w == words - 1 && nbits % 32 ? (1u << (nbits % 32)) - 1 : 0xffffffffu;
+        if (c->tms[i][w] != (tms[w] & m) || c->tdi[i][w] != (tdi ? tdi[w] & m : 0))
+            return false;
+    }
+    return true;
+}
+
+bool shift_cache_get(shift_cache_t *c, const uint32_t *tms, const uint32_t *tdi, int nbits, uint32_t salt,
+                     int *slot)
+{
+    uint64_t key = shift_cache_key(tms, tdi, nbits, salt);
+    int lru = 0;
+    c->stamp++;
+    for (int i = 0; i < SHIFT_CACHE_SLOTS; i++)
+    {
+        if (c->key[i] == key && c->nbits[i] == nbits && c->salt[i] == salt)
+        {
+            if (same(c, i, tms, tdi, nbits))
+            {
+                c->used[i] = c->stamp;
+                c->hits++;
+                c->hit_bits += nbits;
+                *slot = i;
+                return true;
+            }
+            // the key stays unique: the colliding slot is the one refilled
+            c->collisions++;
+            lru = i;
+            break;
+        }
+        // an empty slot is taken first, else the oldest stamp (wrap safe)
+        if (!c->key[lru])
+            continue;
+        if (!c->key[i] || (int32_t)(c->used[i] - c->used[lru]) < 0)
+            lru = i;
+    }
+    int words = (nbits + 31) / 32;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t m = w == words - 1 && nbits % 32 ? (1u << (nbits % 32)) - 1 : 0xffffffffu;
+        c->tms[lru][w] = tms[w] & m;
+        c->tdi[lru][w] = tdi ? tdi[w] & m : 0;
+    }
+    c->key[lru] = key;
+    c->nbits[lru] = (uint16_t)nbits;
+    c->salt[lru] = salt;
+    c->used[lru] = c->stamp;
+    c->misses++;
+    c->miss_bits += nbits;
+    *slot = lru;
+    return false;
+}
+
+uint64_t shift_cache_saved_us(const shift_cache_t *c)
+{
+    return c->miss_bits ? c->hit_bits * c->encode_us / c->miss_bits : 0;
+}
+
+int shift_cache_report(const shift_cache_t *c, const char *layer, char *buf, int size)
+{
+    int n = 0;
+#define EMIT(...)                                          \
+    do                                                     \
+    {                                                      \
+        if (n < size)                                      \
+            n += snprintf(buf + n, size - n, __VA_ARGS__); \
+    } while (0)
+
+    uint32_t lookups = c->hits + c->misses;
+    EMIT("shift_cache_hits{layer=\"%s\"} %lu\n", layer, (unsigned long)c->hits);
+    EMIT("shift_cache_misses{layer=\"%s\"} %lu\n", layer, (unsigned long)c->misses);
+    EMIT("shift_cache_collisions{layer=\"%s\"} %lu\n", layer, (unsigned long)c->collisions);
+    EMIT("shift_cache_hit_bits{layer=\"%s\"} %llu\n", layer, (unsigned long long)c->hit_bits);
+    if (lookups)
+        EMIT("shift_cache_hit_percent{layer=\"%s\"} %lu\n", layer, (unsigned long)((uint64_t)c->hits * 100 / lookups));
+    EMIT("shift_cache_encode_us{layer=\"%s\"} %llu\n", layer, (unsigned long long)c->encode_us);
+    EMIT("shift_cache_saved_us{layer=\"%s\"} %llu\n", layer, (unsigned long long)shift_cache_saved_us(c));
+#undef EMIT
+    return n < size ? n : size - 1;
+}
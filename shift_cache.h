@@ -0,0 +1,56 @@
+#ifndef __SHIFT_CACHE_H__
+#define __SHIFT_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Remembers what a backend layer derived from a shift (the segments of
+// tdi_rle.c, the idle runs of tap_track.c) so a repeated shift - a status
+// poll, an IDCODE or IR scan - goes to the engine without another scan over
+// its bits. A slot is keyed by a 64 bit hash of nbits, the vectors and a salt
+// for the other inputs of the encoding, and keeps the vectors: a key match is
+// a hit only when the vectors compare equal too, so a hash collision costs an
+// encode and not a wrong shift. The owner keeps the encoded form in its own
+// array, one entry per slot, and the least recently used slot is refilled on
+// a miss.
+
+#ifndef SHIFT_CACHE_SLOTS
+#define SHIFT_CACHE_SLOTS 8
+#endif
+#define SHIFT_CACHE_MIN_BITS 33 // one word is walked faster than it is hashed
+#ifndef SHIFT_CACHE_MAX_BITS
+#define SHIFT_CACHE_MAX_BITS 2048 // longer shifts are encoded every time
+#endif
+#define SHIFT_CACHE_WORDS (SHIFT_CACHE_MAX_BITS / 32)
+
+typedef struct shift_cache
+{
+    uint64_t key[SHIFT_CACHE_SLOTS]; // 0: empty
+    uint16_t nbits[SHIFT_CACHE_SLOTS];
+    uint32_t salt[SHIFT_CACHE_SLOTS];
+    uint32_t tms[SHIFT_CACHE_SLOTS][SHIFT_CACHE_WORDS]; // bits above nbits zero
+    uint32_t tdi[SHIFT_CACHE_SLOTS][SHIFT_CACHE_WORDS];
+    uint32_t used[SHIFT_CACHE_SLOTS]; // stamp of the last lookup that found it
+    uint32_t stamp;
+    uint32_t hits, misses;
+    uint32_t collisions; // misses whose key matched a slot of other vectors
+    uint64_t hit_bits, miss_bits;
+    uint64_t encode_us; // the owner's encode time of the misses
+} shift_cache_t;
+
+void shift_cache_init(shift_cache_t *c);
+// tdi may be NULL, bits above nbits are ignored
+uint64_t shift_cache_key(const uint32_t *tms, const uint32_t *tdi, int nbits, uint32_t salt);
+// true and the slot that holds the shift, or false and the least recently
+// used slot, which holds it from now on and has to be encoded into; tdi may be
+// NULL and nbits is at most SHIFT_CACHE_MAX_BITS
+bool shift_cache_get(shift_cache_t *c, const uint32_t *tms, const uint32_t *tdi, int nbits, uint32_t salt,
+                     int *slot);
+// drops every slot, the statistics stay
+void shift_cache_clear(shift_cache_t *c);
+// encode time the hits did not spend, at the mean cost per bit of the misses
+uint64_t shift_cache_saved_us(const shift_cache_t *c);
+// hits, misses and the time saved as text for the layer, returns the length
+int shift_cache_report(const shift_cache_t *c, const char *layer, char *buf, int size);
+
+#endif
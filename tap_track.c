@@ -0,0 +1,179 @@
+#include "tap_track.h"
+#include <string.h>
+
+#include "bitvec.h"
+#include "xvc_stats.h"
+
+static bool idle_state(jtag_state_t s, int tms)
+{
+    switch (s)
+    {
+    case JTAG_TEST_LOGIC_RESET:
+        return tms;
+    case JTAG_RUN_TEST_IDLE:
+    case JTAG_PAUSE_DR:
+    case JTAG_PAUSE_IR:
+        return !tms;
+    default:
+        return false;
+    }
+}
+
+static int literal(tap_track_t *t, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int off, int n)
+{
+    const xvc_backend_t *l = t->lower;
+    if (n <= 0)
+        return 0;
+    if (off == 0)
+        return l->shift(l->ctx, tms, tdi, tdo, n);
+    bitvec_extract(t->tms, tms, off, n);
+    bitvec_extract(t->tdi, tdi, off, n);
+    int r = l->shift(l->ctx, t->tms, t->tdi, t->tdo, n);
+    bitvec_insert(tdo, off, t->tdo, n);
+    return r;
+}
+
+static int idle(tap_track_t *t, uint32_t *tdo, int off, int n, int tms)
+{
+    const xvc_backend_t *l = t->lower;
+    int level = l->idle(l->ctx, tms, n);
+    if (level < 0)
+        return level;
+    bitvec_fill(tdo, off, n, level);
+    xvc_counters.idle_runs++;
+    xvc_counters.idle_bits += n;
+    return 0;
+}
+
+static void add_run(tap_track_plan_t *p, int off, int len, int tms)
+{
+    if (p->nruns < TAP_TRACK_MAX_RUNS)
+        p->runs[p->nruns++] = (tap_track_run_t){(uint16_t)off, (uint16_t)len, (uint8_t)tms};
+}
+
+// walks the TMS bits from the tracked state, notes the idle runs
+static void walk(const tap_track_t *t, const uint32_t *tms, int nbits, tap_track_plan_t *p)
+{
+    jtag_state_t s = t->state;
+    bool known = t->known;
+    int ones = t->ones;
+    int run = -1, run_tms = 0;
+
+    p->nruns = 0;
+    for (int i = 0; i < nbits;)
+    {
+        // a whole word of the run's tms keeps us in the same state
+        if (run >= 0 && !(i & 31) && nbits - i >= 32 && tms[i >> 5] == (run_tms ? 0xffffffffu : 0))
+        {
+            ones = run_tms ? ones + 32 : 0;
+            i += 32;
+            continue;
+        }
+        int b = bitvec_get(tms, i);
+        if (known && idle_state(s, b) && (run < 0 || b == run_tms))
+        {
+            if (run < 0)
+            {
+                run = i;
+                run_tms = b;
+            }
+        }
+        else if (run >= 0)
+        {
+            if (i - run >= t->min_idle)
+                add_run(p, run, i - run, run_tms);
+            run = -1;
+            continue; // look at this bit again, it may start a new run
+        }
+        ones = b ? ones + 1 : 0;
+        s = jtag_step(s, b);
+        if (ones >= 5)
+        {
+            s = JTAG_TEST_LOGIC_RESET;
+            known = true;
+        }
+        i++;
+    }
+    if (run >= 0 && nbits - run >= t->min_idle)
+        add_run(p, run, nbits - run, run_tms);
+    p->state = s;
+    p->known = known;
+    p->ones = ones > 5 ? 5 : ones;
+}
+
+static int tap_track_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    tap_track_t *t = ctx;
+    const tap_track_plan_t *p = &t->plan;
+    int lit = 0, r = 0, slot;
+
+    if (!t->lower->idle)
+        return t->lower->shift(t->lower->ctx, tms, tdi, tdo, nbits);
+    if (t->cached && nbits >= SHIFT_CACHE_MIN_BITS && nbits <= SHIFT_CACHE_MAX_BITS)
+    {
+        // tdi plays no part, the walk starts from the tracked state
+        uint32_t salt = t->state | t->known << 4 | t->ones << 5 | t->min_idle << 8;
+        if (!shift_cache_get(&t->cache, tms, NULL, nbits, salt, &slot))
+        {
+            uint64_t t0 = time_us_64();
+            walk(t, tms, nbits, &t->plans[slot]);
+            t->cache.encode_us += time_us_64() - t0;
+        }
+        p = &t->plans[slot];
+    }
+    else
+    {
+        walk(t, tms, nbits, &t->plan);
+    }
+
+    // the first literal segment is shifted in place and zeroes the tail words
+    if (nbits % 32)
+        tdo[nbits / 32] = 0;
+    for (int i = 0; i < p->nruns; i++)
+    {
+        const tap_track_run_t *run = &p->runs[i];
+        r |= literal(t, tms, tdi, tdo, lit, run->off - lit);
+        r |= idle(t, tdo, run->off, run->len, run->tms);
+        lit = run->off + run->len;
+    }
+    r |= literal(t, tms, tdi, tdo, lit, nbits - lit);
+
+    t->state = p->state;
+    // a failed shift may have stopped anywhere
+    t->known = p->known && r >= 0;
+    t->ones = p->ones;
+    return r;
+}
+
+static uint32_t tap_track_set_tck(void *ctx, uint32_t period_ns)
+{
+    tap_track_t *t = ctx;
+    return t->lower->set_tck ? t->lower->set_tck(t->lower->ctx, period_ns) : period_ns;
+}
+
+static int tap_track_idle(void *ctx, int tms, uint32_t count)
+{
+    tap_track_t *t = ctx;
+    return t->lower->idle(t->lower->ctx, tms, count);
+}
+
+void tap_track_reset(tap_track_t *t)
+{
+    t->state = JTAG_TEST_LOGIC_RESET;
+    t->known = true;
+    t->ones = 5;
+}
+
+void tap_track_init(tap_track_t *t, const xvc_backend_t *lower)
+{
+    memset(t, 0, sizeof(*t));
+    t->lower = lower;
+    t->state = JTAG_TEST_LOGIC_RESET;
+    t->min_idle = TAP_TRACK_MIN_IDLE;
+    t->cached = true;
+    shift_cache_init(&t->cache);
+    t->backend.ctx = t;
+    t->backend.shift = tap_track_shift;
+    t->backend.set_tck = tap_track_set_tck;
+    t->backend.idle = lower->idle ? tap_track_idle : NULL;
+}
@@ -0,0 +1,59 @@
+#ifndef __TAP_TRACK_H__
+#define __TAP_TRACK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "jtag_tap.h"
+#include "shift_cache.h"
+#include "xvc_backend.h"
+#include "xvc_server.h"
+
+// Follows the TAP state through every TMS bit that goes to the chain and
+// hands runs of constant TMS in a stable, non-shifting state (Run-Test/Idle,
+// Test-Logic-Reset, Pause-DR/IR) to the lower backend's idle op, which clocks
+// them from a counter. TDO is not driven in those states, so the level sampled
+// at the start of the run is returned for every bit of it. The walk depends
+// on the TMS bits and the state they start from only, its outcome is cached
+// for the last SHIFT_CACHE_SLOTS distinct pairs.
+
+#define TAP_TRACK_MIN_IDLE 64 // shorter runs are cheaper to shift literally
+#define TAP_TRACK_MAX_RUNS 32 // per shift, later runs are shifted literally
+
+typedef struct tap_track_run
+{
+    uint16_t off;
+    uint16_t len;
+    uint8_t tms;
+} tap_track_run_t;
+
+// the idle runs of a shift, literal segments fill the gaps, and where it leaves the TAP
+typedef struct tap_track_plan
+{
+    int nruns;
+    tap_track_run_t runs[TAP_TRACK_MAX_RUNS];
+    jtag_state_t state;
+    bool known;
+    int ones;
+} tap_track_plan_t;
+
+typedef struct tap_track
+{
+    xvc_backend_t backend; // what the xvc server calls, ctx points back here
+    const xvc_backend_t *lower;
+    jtag_state_t state;
+    bool known; // state is only trusted after five TMS=1 clocks
+    int ones;
+    int min_idle;
+    bool cached; // look the walk up in cache first, on after init
+    shift_cache_t cache;
+    tap_track_plan_t plans[SHIFT_CACHE_SLOTS]; // by cache slot
+    tap_track_plan_t plan;
+    uint32_t tms[XVC_VECTOR_WORDS + 1], tdi[XVC_VECTOR_WORDS + 1], tdo[XVC_VECTOR_WORDS + 1];
+} tap_track_t;
+
+void tap_track_init(tap_track_t *t, const xvc_backend_t *lower);
+// the chain was reset behind the tracker's back (five or more TMS=1 clocks)
+void tap_track_reset(tap_track_t *t);
+
+#endif
@@ -0,0 +1,165 @@
+#include "tdi_rle.h"
+#include <string.h>
+
+#include "bitvec.h"
+#include "xvc_stats.h"
+
+static inline int ctz32(uint32_t x)
+{
+    return x ? __builtin_ctz(x) : 32;
+}
+
+static inline int clz32(uint32_t x)
+{
+    return x ? __builtin_clz(x) : 32;
+}
+
+// bits of word w that differ from the run value, bits past nbits never differ
+static inline uint32_t differ(const uint32_t *tms, const uint32_t *tdi, int nbits, int w, int v_tms, int v_tdi)
+{
+    uint32_t x = (tms[w] ^ (v_tms ? 0xffffffffu : 0)) | (tdi[w] ^ (v_tdi ? 0xffffffffu : 0));
+    int n = nbits - 32 * w;
+    return n >= 32 ? x : x & ((1u << n) - 1);
+}
+
+// appends a segment, literals next to each other are merged
+static int emit(tdi_rle_seg_t *segs, int n, int off, int len, int repeat, int v_tms, int v_tdi)
+{
+    if (len <= 0)
+        return n;
+    if (n && !repeat && !segs[n - 1].repeat)
+    {
+        segs[n - 1].len += len;
+        return n;
+    }
+    segs[n] = (tdi_rle_seg_t){(uint16_t)off, (uint16_t)len, (uint8_t)repeat, (uint8_t)v_tms, (uint8_t)v_tdi};
+    return n + 1;
+}
+
+int tdi_rle_encode(const uint32_t *tms, const uint32_t *tdi, int nbits, int min_run, tdi_rle_seg_t *segs, int max_segs)
+{
+    int words = (nbits + 31) / 32, n = 0, lit = 0;
+    for (int w = 0; w < words;)
+    {
+        int v_tms = tms[w] & 1, v_tdi = tdi[w] & 1;
+        if (differ(tms, tdi, nbits, w, v_tms, v_tdi))
+        {
+            w++;
+            continue;
+        }
+        // whole words of one value, then the bits reaching into the neighbours
+        int end = w + 1;
+        while (end < words && !differ(tms, tdi, nbits, end, v_tms, v_tdi))
+            end++;
+        int start = 32 * w, stop = end < words ? 32 * end : nbits;
+        if (w > 0)
+            start -= clz32(differ(tms, tdi, nbits, w - 1, v_tms, v_tdi));
+        if (end < words)
+            stop += ctz32(differ(tms, tdi, nbits, end, v_tms, v_tdi));
+        if (start < lit)
+            start = lit;
+        // keep room for a literal before the run and one after it
+        if (stop - start >= min_run && n + 3 <= max_segs)
+        {
+            n = emit(segs, n, lit, start - lit, 0, 0, 0);
+            n = emit(segs, n, start, stop - start, 1, v_tms, v_tdi);
+            lit = stop;
+        }
+        w = end;
+    }
+    return emit(segs, n, lit, nbits - lit, 0, 0, 0);
+}
+
+static int literal(tdi_rle_t *r, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int off, int n)
+{
+    const xvc_backend_t *l = r->lower;
+    if (off == 0)
+        return l->shift(l->ctx, tms, tdi, tdo, n);
+    bitvec_extract(r->tms, tms, off, n);
+    bitvec_extract(r->tdi, tdi, off, n);
+    int ret = l->shift(l->ctx, r->tms, r->tdi, r->tdo, n);
+    bitvec_insert(tdo, off, r->tdo, n);
+    return ret;
+}
+
+static int repeat(tdi_rle_t *r, const tdi_rle_seg_t *s, uint32_t *tdo)
+{
+    const xvc_backend_t *l = r->lower;
+    int ret = l->repeat(l->ctx, s->tms, s->tdi, r->tdo, s->len);
+    bitvec_insert(tdo, s->off, r->tdo, s->len);
+    xvc_counters.rle_runs++;
+    xvc_counters.rle_bits += s->len;
+    // a literal shift pushes one tdi and one tms word per 32 bits
+    xvc_counters.rle_words_saved += 2 * ((s->len + 31) / 32) - 1;
+    return ret;
+}
+
+static int tdi_rle_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    tdi_rle_t *r = ctx;
+    const xvc_backend_t *l = r->lower;
+    if (!l->repeat || nbits < r->min_run)
+        return l->shift(l->ctx, tms, tdi, tdo, nbits);
+
+    const tdi_rle_seg_t *segs = r->segs;
+    int n, ret = 0, slot;
+    if (r->cached && nbits <= SHIFT_CACHE_MAX_BITS)
+    {
+        bool hit = shift_cache_get(&r->cache, tms, tdi, nbits, r->min_run, &slot);
+        tdi_rle_plan_t *p = &r->plans[slot];
+        if (!hit)
+        {
+            uint64_t t0 = time_us_64();
+            p->n = tdi_rle_encode(tms, tdi, nbits, r->min_run, p->segs, TDI_RLE_MAX_SEGS);
+            r->cache.encode_us += time_us_64() - t0;
+        }
+        n = p->n;
+        segs = p->segs;
+    }
+    else
+    {
+        n = tdi_rle_encode(tms, tdi, nbits, r->min_run, r->segs, TDI_RLE_MAX_SEGS);
+    }
+    if (n == 1)
+        return l->shift(l->ctx, tms, tdi, tdo, nbits);
+    if (nbits % 32)
+        tdo[nbits / 32] = 0;
+    for (int i = 0; i < n && ret >= 0; i++)
+    {
+        const tdi_rle_seg_t *s = &segs[i];
+        ret |= s->repeat ? repeat(r, s, tdo) : literal(r, tms, tdi, tdo, s->off, s->len);
+    }
+    return ret;
+}
+
+static uint32_t tdi_rle_set_tck(void *ctx, uint32_t period_ns)
+{
+    tdi_rle_t *r = ctx;
+    return r->lower->set_tck ? r->lower->set_tck(r->lower->ctx, period_ns) : period_ns;
+}
+
+static int tdi_rle_idle(void *ctx, int tms, uint32_t count)
+{
+    tdi_rle_t *r = ctx;
+    return r->lower->idle(r->lower->ctx, tms, count);
+}
+
+static int tdi_rle_repeat(void *ctx, int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    tdi_rle_t *r = ctx;
+    return r->lower->repeat(r->lower->ctx, tms, tdi, tdo, count);
+}
+
+void tdi_rle_init(tdi_rle_t *r, const xvc_backend_t *lower)
+{
+    memset(r, 0, sizeof(*r));
+    r->lower = lower;
+    r->min_run = TDI_RLE_MIN_RUN;
+    r->cached = true;
+    shift_cache_init(&r->cache);
+    r->backend.ctx = r;
+    r->backend.shift = tdi_rle_shift;
+    r->backend.set_tck = tdi_rle_set_tck;
+    r->backend.idle = lower->idle ? tdi_rle_idle : NULL;
+    r->backend.repeat = lower->repeat ? tdi_rle_repeat : NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef __TDI_RLE_H__
+#define __TDI_RLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "shift_cache.h"
+#include "xvc_backend.h"
+#include "xvc_server.h"
+
+// Splits a shift into literal segments and repeat segments, where TMS and
+// TDI keep the same value for at least min_run bits (erase patterns, pad and
+// blank configuration frames). Repeat segments go to the lower backend's
+// repeat op, which clocks them from one FIFO word and still captures TDO.
+// The segments of the last SHIFT_CACHE_SLOTS distinct shifts are cached.
+
+#define TDI_RLE_MIN_RUN 64  // one aligned word is always inside such a run
+#define TDI_RLE_MAX_SEGS 64 // later runs are shifted literally
+
+typedef struct tdi_rle_seg
+{
+    uint16_t off;
+    uint16_t len;
+    uint8_t repeat; // 0: literal
+    uint8_t tms, tdi;
+} tdi_rle_seg_t;
+
+typedef struct tdi_rle_plan
+{
+    int n;
+    tdi_rle_seg_t segs[TDI_RLE_MAX_SEGS];
+} tdi_rle_plan_t;
+
+typedef struct tdi_rle
+{
+    xvc_backend_t backend; // ctx points back here
+    const xvc_backend_t *lower;
+    int min_run;
+    bool cached; // look the segments up in cache first, on after init
+    shift_cache_t cache;
+    tdi_rle_plan_t plans[SHIFT_CACHE_SLOTS]; // by cache slot
+    tdi_rle_seg_t segs[TDI_RLE_MAX_SEGS];
+    uint32_t tms[XVC_VECTOR_WORDS + 1], tdi[XVC_VECTOR_WORDS + 1], tdo[XVC_VECTOR_WORDS + 1];
+} tdi_rle_t;
+
+// word at a time scan, returns the number of segments written to segs, which
+// cover [0, nbits) in order
+int tdi_rle_encode(const uint32_t *tms, const uint32_t *tdi, int nbits, int min_run, tdi_rle_seg_t *segs, int max_segs);
+void tdi_rle_init(tdi_rle_t *r, const xvc_backend_t *lower);
+
+#endif
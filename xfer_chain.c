@@ -0,0 +1,42 @@
+#include "xfer_chain.h"
+
+static xfer_cb_t *block(xfer_cb_t *cb, const volatile void *read, volatile void *write, uint32_t count, uint32_t ctrl)
+{
+    cb->read = read;
+    cb->write = write;
+    cb->count = count;
+    cb->ctrl = ctrl;
+    return cb + 1;
+}
+
+static const xfer_cb_t null_block;
+
+void xfer_chain_init(xfer_chain_t *c, const xfer_chain_hw_t *hw)
+{
+    c->hw = hw;
+    c->shifts = 0;
+    c->words = 0;
+    c->bits = 0;
+    c->tms[0] = c->tdi[0] = c->tdo[0] = null_block;
+}
+
+int xfer_chain_add(xfer_chain_t *c, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    const xfer_chain_hw_t *hw = c->hw;
+    int i = c->shifts;
+    uint32_t words = (nbits + 31) / 32;
+    if (i == XFER_CHAIN_MAX || nbits < 1 || nbits > 65536)
+        return -1;
+
+    c->period[i] = xfer_chain_period(nbits);
+    xfer_cb_t *cb = block(&c->tms[2 * i], &c->period[i], hw->tms_fifo, 1, hw->tms_ctrl);
+    *block(cb, tms, hw->tms_fifo, words, hw->tms_ctrl) = null_block;
+    cb = block(&c->tdi[2 * i], &c->period[i], hw->tdi_fifo, 1, hw->tdi_ctrl);
+    *block(cb, tdi, hw->tdi_fifo, words, hw->tdi_ctrl) = null_block;
+    *block(&c->tdo[i], hw->tdo_fifo, tdo, words, hw->tdo_ctrl) = null_block;
+
+    c->shifts++;
+    c->words += words;
+    c->bits += nbits;
+    return 0;
+}
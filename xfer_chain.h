@@ -0,0 +1,61 @@
+#ifndef __XFER_CHAIN_H__
+#define __XFER_CHAIN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// DMA control-block lists that run a batch of shifts back to back on the two
+// tdata state machines. Each stream has a data channel and a control channel
+// that writes one block at a time into the data channel's alias 0 registers
+// (read, write, count, ctrl + trigger); the data channel chains back to its
+// control channel, and an all-zero block is a null trigger that ends the
+// stream. Per shift:
+//   tms stream: period word, then the tms words  -> sm_tms tx fifo
+//   tdi stream: period word, then the tdi words  -> sm_data tx fifo
+//   tdo stream: the tdo words                    <- sm_data rx fifo
+// The state machines pull the period word themselves (tdata.pio, header).
+// sm_tms's dummy tdo goes to a sink channel that needs no blocks. Portable C,
+// the fifo addresses and ctrl words come from an xfer_chain_hw_t so the host
+// can build and check the same lists.
+
+#define XFER_CHAIN_MAX 16 // shifts per chain
+
+typedef struct xfer_cb
+{
+    const volatile void *read;
+    volatile void *write;
+    uint32_t count;
+    uint32_t ctrl; // 0 with the rest: null trigger, end of the stream
+} xfer_cb_t;
+
+typedef struct xfer_chain_hw
+{
+    volatile void *tms_fifo, *tdi_fifo; // tx
+    const volatile void *tdo_fifo;      // rx
+    uint32_t tms_ctrl, tdi_ctrl, tdo_ctrl;
+} xfer_chain_hw_t;
+
+typedef struct xfer_chain
+{
+    const xfer_chain_hw_t *hw;
+    xfer_cb_t tms[2 * XFER_CHAIN_MAX + 1], tdi[2 * XFER_CHAIN_MAX + 1];
+    xfer_cb_t tdo[XFER_CHAIN_MAX + 1];
+    uint32_t period[XFER_CHAIN_MAX];
+    int shifts;
+    uint32_t words; // tdo words of the whole chain
+    uint32_t bits;
+} xfer_chain_t;
+
+// (pad << 16) | (nbits - 1), pad fills the last tdo word up to 32 bits
+static inline uint32_t xfer_chain_period(int nbits)
+{
+    return ((nbits % 32 ? 32u - nbits % 32 : 0u) << 16) | (nbits - 1u);
+}
+
+// empties the chain, cheap enough to do per batch
+void xfer_chain_init(xfer_chain_t *c, const xfer_chain_hw_t *hw);
+// appends a shift of 1 to 65536 bits, returns -1 when the chain is full;
+// the buffers must stay valid until the chain has run
+int xfer_chain_add(xfer_chain_t *c, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits);
+
+#endif
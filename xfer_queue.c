@@ -0,0 +1,171 @@
+#include "xfer_queue.h"
+#include <string.h>
+
+#include "xvc_stats.h"
+
+// the ring is touched from tasks on either core and, later, from the FIFO
+// interrupt, so it is guarded by a hardware spin lock
+#ifdef XVC_HOST
+#define QUEUE_LOCK(q) 0
+#define QUEUE_UNLOCK(q, save) (void)(save)
+#else
+#include "hardware/sync.h"
+#define QUEUE_LOCK(q) spin_lock_blocking((spin_lock_t *)(q)->lock)
+#define QUEUE_UNLOCK(q, save) spin_unlock((spin_lock_t *)(q)->lock, save)
+#endif
+
+void xfer_queue_init(xfer_queue_t *q, const xfer_port_t *port)
+{
+    memset(q, 0, sizeof(*q));
+    q->port = port;
+#ifndef XVC_HOST
+    q->lock = spin_lock_init(spin_lock_claim_unused(true));
+#endif
+}
+
+int xfer_queue_submit(xfer_queue_t *q, xfer_req_t *req)
+{
+    req->status = XFER_PENDING;
+    req->started = false;
+    req->tx = 0;
+    req->rx = 0;
+    uint32_t save = QUEUE_LOCK(q);
+    if (q->count == XFER_QUEUE_DEPTH)
+    {
+        QUEUE_UNLOCK(q, save);
+        return -1;
+    }
+    q->ring[(q->head + q->count) % XFER_QUEUE_DEPTH] = req;
+    q->count++;
+    QUEUE_UNLOCK(q, save);
+    return 0;
+}
+
+// the head request stalled: reset the engine and fail everything queued,
+// the words already in the fifos are gone with it
+static int timeout(xfer_queue_t *q, xfer_req_t *head)
+{
+    xfer_req_t *ring[XFER_QUEUE_DEPTH];
+    q->port->reset(q->port->ctx, head->nbits);
+    uint32_t save = QUEUE_LOCK(q);
+    int n = q->count;
+    for (int i = 0; i < n; i++)
+        ring[i] = q->ring[(q->head + i) % XFER_QUEUE_DEPTH];
+    q->head = (q->head + n) % XFER_QUEUE_DEPTH;
+    q->count = 0;
+    QUEUE_UNLOCK(q, save);
+    for (int i = 0; i < n; i++)
+    {
+        ring[i]->status = XFER_TIMEOUT;
+        if (ring[i]->done)
+            ring[i]->done(ring[i]);
+    }
+    return n;
+}
+
+static int service(xfer_queue_t *q, bool may_start)
+{
+    const xfer_port_t *p = q->port;
+    int completed = 0;
+
+    uint32_t save = QUEUE_LOCK(q);
+    if (q->busy || !q->count)
+    {
+        QUEUE_UNLOCK(q, save);
+        return 0;
+    }
+    q->busy = true;
+    QUEUE_UNLOCK(q, save);
+
+    while (1)
+    {
+        // only the servicer moves head, submit just appends
+        if (!q->count)
+            break;
+        xfer_req_t *r = q->ring[q->head];
+        int words = (r->nbits + 31) / 32;
+        bool progress = false;
+
+        if (!r->started)
+        {
+            if (!may_start)
+                break;
+            p->start(p->ctx, r->nbits);
+            r->started = true;
+            r->deadline = r->timeout_us ? time_us_64() + r->timeout_us : 0;
+        }
+        while (r->rx < words && !p->rx_empty(p->ctx))
+        {
+            r->tdo[r->rx++] = p->get(p->ctx);
+            progress = true;
+        }
+        while (r->tx < words && r->tx - r->rx < p->window && !p->tx_full(p->ctx))
+        {
+            p->put(p->ctx, r->tms[r->tx], r->tdi[r->tx]);
+            r->tx++;
+            progress = true;
+        }
+        if (r->rx == words)
+        {
+            save = QUEUE_LOCK(q);
+            q->head = (q->head + 1) % XFER_QUEUE_DEPTH;
+            q->count--;
+            QUEUE_UNLOCK(q, save);
+            r->status = 0;
+            if (r->done)
+                r->done(r);
+            completed++;
+            continue;
+        }
+        if (!progress)
+        {
+            // the clock is only read once the fifos have nothing to offer
+            if (r->deadline && p->reset && time_us_64() > r->deadline)
+                completed += timeout(q, r);
+            break;
+        }
+    }
+
+    q->busy = false;
+    return completed;
+}
+
+int xfer_queue_service(xfer_queue_t *q)
+{
+    return service(q, true);
+}
+
+int xfer_queue_service_started(xfer_queue_t *q)
+{
+    return service(q, false);
+}
+
+int xfer_queue_wait(xfer_queue_t *q, xfer_req_t *req)
+{
+    while (req->status == XFER_PENDING)
+        xfer_queue_service(q);
+    return req->status;
+}
+
+int xfer_queue_wants(const xfer_queue_t *q)
+{
+    if (!q->count)
+        return 0;
+    const xfer_req_t *r = q->ring[q->head];
+    int words = (r->nbits + 31) / 32, want = XFER_WANT_RX;
+    if (!r->started)
+        return XFER_WANT_START;
+    if (r->tx < words && r->tx - r->rx < q->port->window)
+        want |= XFER_WANT_TX;
+    return want;
+}
+
+int xfer_queue_abort(xfer_queue_t *q)
+{
+    // a servicer on the other core finishes first
+    while (q->busy)
+        ;
+    if (!q->count || !q->port->reset)
+        return 0;
+    return timeout(q, q->ring[q->head]);
+}
@@ -0,0 +1,82 @@
+#ifndef __XFER_QUEUE_H__
+#define __XFER_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Asynchronous shift engine behind the pio_xfer_submit() API. Requests run
+// one after the other in submission order; xfer_queue_service() moves
+// whatever words the FIFOs accept or hold without blocking and completes the
+// head request once its last TDO word is in. Portable C, the FIFOs are
+// reached through an xfer_port_t so the host can drive it with a fake.
+
+#define XFER_QUEUE_DEPTH 4 // requests in flight, submit fails beyond
+
+#define XFER_PENDING 1
+#define XFER_TIMEOUT (-1) // status of a request the engine stalled on
+
+// what the head request waits for, see xfer_queue_wants()
+#define XFER_WANT_RX 1
+#define XFER_WANT_TX 2
+#define XFER_WANT_START 4 // the head is not started, only xfer_queue_service() does
+
+struct xfer_req;
+typedef void (*xfer_done_fn)(struct xfer_req *req);
+
+typedef struct xfer_req
+{
+    const uint32_t *tms, *tdi;
+    uint32_t *tdo;
+    int nbits;
+    xfer_done_fn done; // optional, runs in the context that completed it
+    void *arg;         // for done
+    uint32_t timeout_us; // from the start on the engine, 0 waits forever
+    volatile int status; // XFER_PENDING until done, then 0 or XFER_TIMEOUT
+    // engine
+    bool started;
+    uint64_t deadline;
+    uint16_t tx, rx; // words pushed and pulled
+} xfer_req_t;
+
+typedef struct xfer_port
+{
+    void *ctx;
+    int window;                         // words pushed ahead of the last one pulled
+    void (*start)(void *ctx, int nbits); // load the bit count of the next request
+    bool (*tx_full)(void *ctx);
+    void (*put)(void *ctx, uint32_t tms, uint32_t tdi);
+    bool (*rx_empty)(void *ctx);
+    uint32_t (*get)(void *ctx);
+    // stops and empties the engine after the head request of nbits missed
+    // its deadline; every queued request then fails with XFER_TIMEOUT
+    void (*reset)(void *ctx, int nbits);
+} xfer_port_t;
+
+typedef struct xfer_queue
+{
+    const xfer_port_t *port;
+    xfer_req_t *ring[XFER_QUEUE_DEPTH];
+    volatile int head, count;
+    volatile bool busy; // somebody is inside service
+    void *lock;
+} xfer_queue_t;
+
+void xfer_queue_init(xfer_queue_t *q, const xfer_port_t *port);
+// returns 0, or -1 when XFER_QUEUE_DEPTH requests are in flight
+int xfer_queue_submit(xfer_queue_t *q, xfer_req_t *req);
+// makes progress without blocking, returns the number of completed requests
+int xfer_queue_service(xfer_queue_t *q);
+// the same up to a request that is not started: port->start may wait for the
+// engine, an interrupt handler calls this and leaves the start to a task
+int xfer_queue_service_started(xfer_queue_t *q);
+// services until req is done
+int xfer_queue_wait(xfer_queue_t *q, xfer_req_t *req);
+// XFER_WANT_* bits for the fifo events that would let service progress, 0
+// with nothing queued; an interrupt driven servicer arms exactly these, or
+// hands over to a task on XFER_WANT_START
+int xfer_queue_wants(const xfer_queue_t *q);
+// resets the engine and fails everything queued, for a servicer that is not
+// called while the engine is stalled; returns the number of failed requests
+int xfer_queue_abort(xfer_queue_t *q);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __XVC_BACKEND_H__
+#define __XVC_BACKEND_H__
+
+#include <stdint.h>
+
+// Something that can clock a shift: the PIO engine on the board, a model or
+// a loopback on the host. Vectors are LSB first, word aligned and padded to
+// whole 32 bit words; tdo bits above nbits come back as zero.
+typedef struct xvc_backend
+{
+    void *ctx;
+    int (*shift)(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits);
+    // returns the period actually used, NULL keeps the current tck
+    uint32_t (*set_tck)(void *ctx, uint32_t period_ns);
+    // optional: count clocks with constant tms and no per bit data, returns
+    // the tdo level sampled on the first clock or < 0 on error
+    int (*idle)(void *ctx, int tms, uint32_t count);
+    // optional: count clocks with constant tms and tdi, tdo is captured from
+    // bit 0 and the bits above count in the last word are zero
+    int (*repeat)(void *ctx, int tms, int tdi, uint32_t *tdo, uint32_t count);
+} xvc_backend_t;
+
+#endif
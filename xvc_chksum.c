@@ -0,0 +1,280 @@
+#include "xvc_chksum.h"
+#include <string.h>
+
+#define SUM_BLOCK 48  // bytes per round of the sum loop
+#define COPY_BLOCK 32 // and of the copy loop
+
+static uint16_t fold(uint64_t s)
+{
+    while (s >> 16)
+        s = (s & 0xffff) + (s >> 16);
+    return (uint16_t)s;
+}
+
+static uint16_t swap16(uint16_t v)
+{
+    return (uint16_t)(v << 8 | v >> 8);
+}
+
+static uint32_t load32(const uint8_t *b)
+{
+    uint32_t w;
+    memcpy(&w, b, 4);
+    return w;
+}
+
+#if defined(__ARM_ARCH_6M__)
+// Four ldmia of three words per round, each added with carry. cmp clobbers
+// the carry flag, so the carry out of a round is counted in a register of its
+// own; end sits in a high register, cmp is the only instruction reading it.
+// 33 cycles per 48 bytes.
+static uint64_t sum_blocks(const uint8_t *b, int blocks)
+{
+    const uint8_t *end = b + blocks * SUM_BLOCK;
+    uint32_t sum = 0, carries = 0;
+    __asm volatile(".syntax unified\n"
+                   "1: ldmia %[p]!, {r4, r5, r6}\n"
+                   "   adds %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   adcs %[s], r6\n"
+                   "   ldmia %[p]!, {r4, r5, r6}\n"
+                   "   adcs %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   adcs %[s], r6\n"
+                   "   ldmia %[p]!, {r4, r5, r6}\n"
+                   "   adcs %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   adcs %[s], r6\n"
+                   "   ldmia %[p]!, {r4, r5, r6}\n"
+                   "   adcs %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   adcs %[s], r6\n"
+                   "   movs r4, #0\n"
+                   "   adcs %[c], r4\n"
+                   "   cmp %[p], %[e]\n"
+                   "   bne 1b\n"
+                   : [p] "+l"(b), [s] "+l"(sum), [c] "+l"(carries)
+                   : [e] "h"(end)
+                   : "r4", "r5", "r6", "cc", "memory");
+    return (uint64_t)sum + carries;
+}
+
+// the same with a stmia after every ldmia, two words at a time to leave
+// low registers for both pointers; 37 cycles per 32 bytes
+static uint64_t copy_blocks(uint8_t *d, const uint8_t *s, int blocks)
+{
+    const uint8_t *end = s + blocks * COPY_BLOCK;
+    uint32_t sum = 0, carries = 0;
+    __asm volatile(".syntax unified\n"
+                   "1: ldmia %[src]!, {r4, r5}\n"
+                   "   stmia %[dst]!, {r4, r5}\n"
+                   "   adds %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   ldmia %[src]!, {r4, r5}\n"
+                   "   stmia %[dst]!, {r4, r5}\n"
+                   "   adcs %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   ldmia %[src]!, {r4, r5}\n"
+                   "   stmia %[dst]!, {r4, r5}\n"
+                   "   adcs %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   ldmia %[src]!, {r4, r5}\n"
+                   "   stmia %[dst]!, {r4, r5}\n"
+                   "   adcs %[s], r4\n"
+                   "   adcs %[s], r5\n"
+                   "   movs r4, #0\n"
+                   "   adcs %[c], r4\n"
+                   "   cmp %[src], %[e]\n"
+                   "   bne 1b\n"
+                   : [dst] "+l"(d), [src] "+l"(s), [s] "+l"(sum), [c] "+l"(carries)
+                   : [e] "h"(end)
+                   : "r4", "r5", "cc", "memory");
+    return (uint64_t)sum + carries;
+}
+#else
+static uint64_t sum_blocks(const uint8_t *b, int blocks)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < blocks * SUM_BLOCK; i += 4)
+        sum += load32(b + i);
+    return sum;
+}
+
+static uint64_t copy_blocks(uint8_t *d, const uint8_t *s, int blocks)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < blocks * COPY_BLOCK; i += 4)
+    {
+        uint32_t w = load32(s + i);
+        memcpy(d + i, &w, 4);
+        sum += w;
+    }
+    return sum;
+}
+#endif
+
+uint16_t xvc_chksum(const void *data, int len)
+{
+    const uint8_t *b = data;
+    int odd = (uintptr_t)b & 1;
+    uint64_t sum = 0;
+
+    // an odd start is summed as if a zero byte came first, then swapped back
+    if (odd && len > 0)
+    {
+        sum = (uint32_t)*b++ << 8;
+        len--;
+    }
+    if (((uintptr_t)b & 2) && len >= 2)
+    {
+        sum += b[0] | b[1] << 8;
+        b += 2;
+        len -= 2;
+    }
+    int blocks = len / SUM_BLOCK;
+    if (blocks)
+    {
+        sum += sum_blocks(b, blocks);
+        b += blocks * SUM_BLOCK;
+        len -= blocks * SUM_BLOCK;
+    }
+    for (; len >= 4; b += 4, len -= 4)
+        sum += load32(b);
+    if (len >= 2)
+    {
+        sum += b[0] | b[1] << 8;
+        b += 2;
+        len -= 2;
+    }
+    if (len)
+        sum += b[0];
+    return odd ? swap16(fold(sum)) : fold(sum);
+}
+
+uint16_t xvc_chksum_copy(void *dst, const void *src, int len)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    if ((((uintptr_t)d ^ (uintptr_t)s) & 3) || len < 2 * COPY_BLOCK)
+    {
+        memcpy(dst, src, len);
+        return xvc_chksum(dst, len);
+    }
+
+    // up to three bytes until both are word aligned, by their position
+    uint64_t head = 0, sum = 0;
+    int pos = 0;
+    for (; (uintptr_t)s & 3; pos++, len--)
+    {
+        head += (uint32_t)*s << (pos & 1 ? 8 : 0);
+        *d++ = *s++;
+    }
+    int blocks = len / COPY_BLOCK;
+    sum = copy_blocks(d, s, blocks);
+    d += blocks * COPY_BLOCK;
+    s += blocks * COPY_BLOCK;
+    len -= blocks * COPY_BLOCK;
+    for (; len >= 4; d += 4, s += 4, len -= 4)
+    {
+        uint32_t w = load32(s);
+        memcpy(d, &w, 4);
+        sum += w;
+    }
+    for (int i = 0; i < len; i++)
+    {
+        sum += (uint32_t)s[i] << (i & 1 ? 8 : 0);
+        d[i] = s[i];
+    }
+    // the aligned part started at an odd offset: its bytes pair the other way
+    uint16_t rest = pos & 1 ? swap16(fold(sum)) : fold(sum);
+    return fold(head + rest);
+}
+
+int xvc_frame_copy(void *dst, const void *src, int len)
+{
+    const uint8_t *f = src;
+    uint8_t *d = dst;
+
+    // ethernet II, IPv4, protocol TCP
+    if (len < 14 + 20 || f[12] != 0x08 || f[13] != 0x00 || f[14] >> 4 != 4 || f[23] != 6)
+    {
+        memcpy(dst, src, len);
+        return 0;
+    }
+    int ihl = (f[14] & 15) * 4, total = f[16] << 8 | f[17], seg = total - ihl;
+    int fragment = (f[20] & 0x20) || ((f[20] & 0x1f) << 8 | f[21]);
+    if (ihl < 20 || seg < 0 || 14 + total > len || fragment)
+    {
+        memcpy(dst, src, len);
+        return -1;
+    }
+    memcpy(d, f, 14 + ihl);
+    uint64_t sum = xvc_chksum_copy(d + 14 + ihl, f + 14 + ihl, seg);
+    memcpy(d + 14 + total, f + 14 + total, len - 14 - total); // ethernet padding
+    // pseudo header: source and destination address, zero, protocol, length
+    sum += xvc_chksum(f + 26, 8) + 0x0600 + swap16((uint16_t)seg);
+    return fold(sum) == 0xffff ? 1 : -1;
+}
+
+#ifdef XVC_UBENCH
+#include <stdio.h>
+#include "hardware/clocks.h"
+#include "pico/time.h"
+
+uint16_t lwip_standard_chksum(const void *dataptr, int len);
+
+static uint8_t bench_src[1536 + 8], bench_dst[1536 + 8];
+
+static double cycles_per_byte(uint64_t us, int rounds, int len)
+{
+    return us * (clock_get_hz(clk_sys) / 1e6) / ((double)rounds * len);
+}
+
+void xvc_chksum_ubench(void)
+{
+    const int len = 1460, rounds = 200;
+    int bad = 0;
+    uint32_t seed = 1;
+    for (unsigned i = 0; i < sizeof(bench_src); i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        bench_src[i] = seed >> 24;
+    }
+    // every alignment of both buffers, lengths around the block sizes
+    for (int so = 0; so < 4; so++)
+        for (int dof = 0; dof < 4; dof++)
+            for (int n = 0; n < 200; n += 1 + n / 16)
+            {
+                uint16_t ref = lwip_standard_chksum(bench_src + so, n);
+                bad += xvc_chksum(bench_src + so, n) != ref;
+                bad += xvc_chksum_copy(bench_dst + dof, bench_src + so, n) != ref;
+                bad += memcmp(bench_dst + dof, bench_src + so, n) != 0;
+            }
+    printf("ubench: checksum %d mismatches against lwIP\n", bad);
+
+    volatile uint16_t sink = 0;
+    uint64_t t0 = time_us_64();
+    for (int r = 0; r < rounds; r++)
+        sink += lwip_standard_chksum(bench_src, len);
+    uint64_t t1 = time_us_64();
+    for (int r = 0; r < rounds; r++)
+        sink += xvc_chksum(bench_src, len);
+    uint64_t t2 = time_us_64();
+    for (int r = 0; r < rounds; r++)
+        sink += xvc_chksum(bench_src + 1, len);
+    uint64_t t3 = time_us_64();
+    for (int r = 0; r < rounds; r++)
+    {
+        memcpy(bench_dst, bench_src, len);
+        sink += xvc_chksum(bench_dst, len);
+    }
+    uint64_t t4 = time_us_64();
+    for (int r = 0; r < rounds; r++)
+        sink += xvc_chksum_copy(bench_dst, bench_src, len);
+    uint64_t t5 = time_us_64();
+    printf("ubench: %d byte cycles/byte: lwip %.2f  sum %.2f  sum odd %.2f  memcpy+sum %.2f  copy+sum %.2f\n", len,
+           cycles_per_byte(t1 - t0, rounds, len), cycles_per_byte(t2 - t1, rounds, len),
+           cycles_per_byte(t3 - t2, rounds, len), cycles_per_byte(t4 - t3, rounds, len),
+           cycles_per_byte(t5 - t4, rounds, len));
+}
+#endif
@@ -0,0 +1,30 @@
+#ifndef __XVC_CHKSUM_H__
+#define __XVC_CHKSUM_H__
+
+#include <stdint.h>
+
+// Internet checksum for lwIP (LWIP_CHKSUM, LWIP_CHKSUM_COPY in lwipopts.h).
+// The result is lwIP's: the folded one's complement sum of the data read as
+// little endian 16 bit words from its first byte, whatever its alignment,
+// not inverted. On the M0+ the bulk runs in ldmia/adcs loops, elsewhere
+// (host checks) in plain C with a 64 bit accumulator.
+
+uint16_t xvc_chksum(const void *data, int len);
+// memcpy(dst, src, len) and the checksum of the bytes, in one pass when
+// dst and src have the same alignment mod 4
+uint16_t xvc_chksum_copy(void *dst, const void *src, int len);
+
+// Copies an ethernet frame. An IPv4 TCP segment is checksummed while it is
+// copied and verified against its pseudo header, so lwIP need not read it a
+// second time (NETIF_CHECKSUM_CHECK_TCP is off on the usb netif). Returns 1
+// for a verified segment, 0 for anything else and -1 for a bad checksum, a
+// malformed header or a fragmented TCP datagram, which cannot be verified
+// per frame.
+int xvc_frame_copy(void *dst, const void *src, int len);
+
+#ifdef XVC_UBENCH
+// cycles per byte against lwip_standard_chksum() and a result check, on the uart
+void xvc_chksum_ubench(void);
+#endif
+
+#endif
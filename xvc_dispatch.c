@@ -0,0 +1,186 @@
+#include "xvc_dispatch.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "dlog.h"
+#include "xvc_stats.h"
+
+// each path runs shifts of a bin for at least this long, well above the
+// 1 us timer, a full buffer at a slow tck takes one shift
+#define CALIB_US 2000
+
+static int bin_of(int nbits)
+{
+    return nbits <= 1 ? 0 : 32 - __builtin_clz((uint32_t)nbits - 1);
+}
+
+static bool path_takes(const dispatch_path_t *p, int nbits)
+{
+    return !p->max_bits || nbits <= p->max_bits;
+}
+
+static int dispatch_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    xvc_dispatch_t *d = ctx;
+    int b = bin_of(nbits), i = d->table ? d->table->best[b] : 0;
+    // a path that is best for the bin may still be too short for this length
+    if (!path_takes(&d->paths[i], nbits))
+        i = 0;
+    d->usage[i][b]++;
+    const xvc_backend_t *l = d->paths[i].backend;
+    return l->shift(l->ctx, tms, tdi, tdo, nbits);
+}
+
+// the table of period_ns, or with create an empty slot for it, else the
+// nearest one, which is recycled
+static dispatch_table_t *find_table(xvc_dispatch_t *d, uint32_t period_ns, bool create)
+{
+    dispatch_table_t *nearest = NULL, *empty = NULL;
+    uint32_t dist = UINT32_MAX;
+    for (int i = 0; i < DISPATCH_TABLES; i++)
+    {
+        dispatch_table_t *t = &d->tables[i];
+        if (!t->used)
+        {
+            if (!empty)
+                empty = t;
+            continue;
+        }
+        uint32_t delta = t->period_ns > period_ns ? t->period_ns - period_ns : period_ns - t->period_ns;
+        if (delta < dist)
+        {
+            dist = delta;
+            nearest = t;
+        }
+    }
+    if (!create || !dist)
+        return nearest;
+    dispatch_table_t *t = empty ? empty : nearest;
+    t->period_ns = period_ns;
+    t->used = true;
+    return t;
+}
+
+static uint32_t dispatch_set_tck(void *ctx, uint32_t period_ns)
+{
+    xvc_dispatch_t *d = ctx;
+    const xvc_backend_t *l = d->paths[0].backend;
+    // every path drives the same pins, so the first one sets the clock
+    if (l->set_tck)
+        period_ns = l->set_tck(l->ctx, period_ns);
+    d->period_ns = period_ns;
+    // an uncalibrated tck borrows the nearest table, calibrating here would
+    // reset the TAP in the middle of a session
+    d->table = find_table(d, period_ns, false);
+    return period_ns;
+}
+
+static int dispatch_idle(void *ctx, int tms, uint32_t count)
+{
+    xvc_dispatch_t *d = ctx;
+    const xvc_backend_t *l = d->paths[0].backend;
+    return l->idle(l->ctx, tms, count);
+}
+
+static int dispatch_repeat(void *ctx, int tms, int tdi, uint32_t *tdo, uint32_t count)
+{
+    xvc_dispatch_t *d = ctx;
+    const xvc_backend_t *l = d->paths[0].backend;
+    return l->repeat(l->ctx, tms, tdi, tdo, count);
+}
+
+void xvc_dispatch_init(xvc_dispatch_t *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->backend.ctx = d;
+    d->backend.shift = dispatch_shift;
+    d->backend.set_tck = dispatch_set_tck;
+}
+
+int xvc_dispatch_add(xvc_dispatch_t *d, const char *name, const xvc_backend_t *backend, int max_bits)
+{
+    if (d->npaths == DISPATCH_MAX_PATHS || (!d->npaths && max_bits))
+        return -1; // the default path has to take any length
+    d->paths[d->npaths++] = (dispatch_path_t){name, backend, max_bits};
+    if (d->npaths == 1)
+    {
+        d->backend.idle = backend->idle ? dispatch_idle : NULL;
+        d->backend.repeat = backend->repeat ? dispatch_repeat : NULL;
+    }
+    return 0;
+}
+
+void xvc_dispatch_calibrate(xvc_dispatch_t *d)
+{
+    dispatch_table_t *t = find_table(d, d->period_ns, true);
+    memset(d->tms, 0xff, sizeof(d->tms));
+    memset(d->tdi, 0, sizeof(d->tdi));
+    for (int b = 0; b < DISPATCH_BINS; b++)
+    {
+        int nbits = 1 << b;
+        t->best[b] = 0;
+        for (int i = 0; i < d->npaths; i++)
+        {
+            const xvc_backend_t *l = d->paths[i].backend;
+            t->cost_ns[i][b] = 0;
+            if (!path_takes(&d->paths[i], nbits))
+                continue;
+            uint64_t t0 = time_us_64(), us;
+            uint32_t rounds = 0;
+            bool failed = false;
+            do
+            {
+                failed = l->shift(l->ctx, d->tms, d->tdi, d->tdo, nbits) < 0;
+                rounds++;
+            } while (!failed && (us = time_us_64() - t0) < CALIB_US);
+            // a path that fails would be timed as the fastest, it keeps cost 0
+            // and takes no shifts of the bin
+            if (failed)
+            {
+                DLOG2(DISPATCH_CALIB_ERR, i, nbits);
+                continue;
+            }
+            uint64_t ns = us * 1000 / rounds;
+            t->cost_ns[i][b] = ns ? (uint32_t)ns : 1;
+            if (!t->cost_ns[t->best[b]][b] || t->cost_ns[i][b] < t->cost_ns[t->best[b]][b])
+                t->best[b] = i;
+        }
+    }
+    d->table = t;
+}
+
+int xvc_dispatch_report(const xvc_dispatch_t *d, char *buf, int size)
+{
+    int n = 0;
+#define EMIT(...)                                          \
+    do                                                     \
+    {                                                      \
+        if (n < size)                                      \
+            n += snprintf(buf + n, size - n, __VA_ARGS__); \
+    } while (0)
+
+    const dispatch_table_t *t = d->table;
+    EMIT("dispatch_tck_period_ns %lu\n", (unsigned long)d->period_ns);
+    if (t)
+    {
+        EMIT("dispatch_table_period_ns %lu\n", (unsigned long)t->period_ns);
+        // a threshold is the first length bin where another path wins
+        for (int b = 0; b < DISPATCH_BINS; b++)
+        {
+            if (b == 0 || t->best[b] != t->best[b - 1])
+                EMIT("dispatch_from_bits{path=\"%s\"} %d\n", d->paths[t->best[b]].name, b ? (1 << (b - 1)) + 1 : 1);
+        }
+        for (int i = 0; i < d->npaths; i++)
+            for (int b = 0; b < DISPATCH_BINS; b++)
+                if (t->cost_ns[i][b])
+                    EMIT("dispatch_cost_ns{path=\"%s\",bits=\"%d\"} %lu\n", d->paths[i].name, 1 << b,
+                         (unsigned long)t->cost_ns[i][b]);
+    }
+    for (int i = 0; i < d->npaths; i++)
+        for (int b = 0; b < DISPATCH_BINS; b++)
+            if (d->usage[i][b])
+                EMIT("dispatch_shifts{path=\"%s\",bits=\"<=%d\"} %lu\n", d->paths[i].name, 1 << b,
+                     (unsigned long)d->usage[i][b]);
+#undef EMIT
+    return n < size ? n : size - 1;
+}
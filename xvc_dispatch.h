@@ -0,0 +1,53 @@
+#ifndef __XVC_DISPATCH_H__
+#define __XVC_DISPATCH_H__
+
+#include <stdint.h>
+
+#include "xvc_backend.h"
+#include "xvc_server.h"
+
+// Routes each shift to the cheapest of several equivalent shift paths. The
+// cost of every path is measured per log2 length bin by xvc_dispatch_calibrate()
+// with TMS held high, so a real chain just sits in Test-Logic-Reset, and the
+// winners are kept per TCK period.
+
+#define DISPATCH_MAX_PATHS 4
+#define DISPATCH_BINS 14  // bin b holds lengths (2^(b-1), 2^b], up to 8192
+#define DISPATCH_TABLES 4 // tck settings remembered
+
+typedef struct dispatch_path
+{
+    const char *name;
+    const xvc_backend_t *backend;
+    int max_bits; // longest shift the path takes, 0: any
+} dispatch_path_t;
+
+typedef struct dispatch_table
+{
+    uint32_t period_ns; // 0 before the first settck:
+    bool used;
+    uint8_t best[DISPATCH_BINS];
+    uint32_t cost_ns[DISPATCH_MAX_PATHS][DISPATCH_BINS]; // per shift, 0: not measured
+} dispatch_table_t;
+
+typedef struct xvc_dispatch
+{
+    xvc_backend_t backend; // ctx points back here
+    dispatch_path_t paths[DISPATCH_MAX_PATHS];
+    int npaths;
+    uint32_t period_ns; // current tck
+    dispatch_table_t tables[DISPATCH_TABLES];
+    dispatch_table_t *table; // for period_ns, NULL before the first calibration
+    uint32_t usage[DISPATCH_MAX_PATHS][DISPATCH_BINS];
+    uint32_t tms[XVC_VECTOR_WORDS], tdi[XVC_VECTOR_WORDS], tdo[XVC_VECTOR_WORDS + 1];
+} xvc_dispatch_t;
+
+// the first path is the default and lends its idle, repeat and set_tck ops
+void xvc_dispatch_init(xvc_dispatch_t *d);
+int xvc_dispatch_add(xvc_dispatch_t *d, const char *name, const xvc_backend_t *backend, int max_bits);
+// measures every path at the current tck, clocks the chain with TMS=1
+void xvc_dispatch_calibrate(xvc_dispatch_t *d);
+// thresholds, costs and the usage histogram as text, returns the length
+int xvc_dispatch_report(const xvc_dispatch_t *d, char *buf, int size);
+
+#endif
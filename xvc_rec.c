@@ -0,0 +1,177 @@
+#include "xvc_rec.h"
+#include <string.h>
+
+#include "dlog.h"
+#include "jtag_ops.h"
+
+// every page was erased at start
+static void put_page(xvc_rec_t *r)
+{
+    uint32_t off = XVC_REC_PAGE + r->off - r->fill;
+    if (r->fill < XVC_REC_PAGE)
+        memset((uint8_t *)r->page + r->fill, 0xff, XVC_REC_PAGE - r->fill);
+    if (!r->full && r->store->program(off, r->page, XVC_REC_PAGE) < 0)
+        r->full = true;
+    r->fill = 0;
+}
+
+static void put(xvc_rec_t *r, const uint32_t *words, uint32_t count)
+{
+    while (count)
+    {
+        uint32_t n = (XVC_REC_PAGE - r->fill) / 4;
+        if (n > count)
+            n = count;
+        memcpy((uint8_t *)r->page + r->fill, words, n * 4);
+        r->fill += n * 4;
+        r->off += n * 4;
+        words += n;
+        count -= n;
+        if (r->fill == XVC_REC_PAGE)
+            put_page(r);
+    }
+}
+
+static void append(xvc_rec_t *r, const uint32_t *tms, const uint32_t *tdi, const uint32_t *tdo, int nbits)
+{
+    uint32_t words = (nbits + 31) / 32, n = nbits;
+    if (XVC_REC_PAGE + r->off + 4 + 12 * words > r->store->size)
+    {
+        if (!r->full)
+            DLOG1(REC_FULL, r->records);
+        r->full = true;
+        return;
+    }
+    put(r, &n, 1);
+    put(r, tms, words);
+    put(r, tdi, words);
+    put(r, tdo, words);
+    r->records++;
+}
+
+static int rec_shift(void *ctx, const uint32_t *tms, const uint32_t *tdi, uint32_t *tdo, int nbits)
+{
+    xvc_rec_t *r = ctx;
+    int ret = r->lower->shift(r->lower->ctx, tms, tdi, tdo, nbits);
+    if (ret >= 0 && r->recording && !r->full)
+    {
+        // replay compares whole words
+        if (nbits % 32)
+            tdo[nbits / 32] &= (1u << (nbits % 32)) - 1;
+        append(r, tms, tdi, tdo, nbits);
+    }
+    return ret;
+}
+
+static uint32_t rec_set_tck(void *ctx, uint32_t period_ns)
+{
+    xvc_rec_t *r = ctx;
+    return r->lower->set_tck ? r->lower->set_tck(r->lower->ctx, period_ns) : period_ns;
+}
+
+void xvc_rec_init(xvc_rec_t *r, const xvc_backend_t *lower, const xvc_rec_store_t *store)
+{
+    memset(r, 0, sizeof(*r));
+    r->lower = lower;
+    r->store = store;
+    r->backend.ctx = r;
+    r->backend.shift = rec_shift;
+    r->backend.set_tck = rec_set_tck;
+    // idle and repeat only exist below the tracker, nothing above calls them
+}
+
+static bool blank(const uint8_t *p, uint32_t len)
+{
+    const uint32_t *w = (const uint32_t *)p;
+    for (uint32_t i = 0; i < len / 4; i++)
+        if (w[i] != 0xffffffffu)
+            return false;
+    return true;
+}
+
+int xvc_rec_start(xvc_rec_t *r)
+{
+    r->recording = false;
+    if (r->track && !r->track->known)
+    {
+        DLOG0(REC_NO_STATE);
+        return -1;
+    }
+    // a block at a time, so interrupts run between the erases
+    for (uint32_t off = 0; off < r->store->size; off += XVC_REC_BLOCK)
+    {
+        if (!blank(r->store->base + off, XVC_REC_BLOCK) && r->store->erase(off, XVC_REC_BLOCK) < 0)
+            return -1;
+    }
+    r->start = r->track ? r->track->state : JTAG_TEST_LOGIC_RESET;
+    r->records = 0;
+    r->off = 0;
+    r->fill = 0;
+    r->full = false;
+    r->recording = true;
+    DLOG0(REC_START);
+    return 0;
+}
+
+int xvc_rec_stop(xvc_rec_t *r)
+{
+    if (!r->recording)
+        return -1;
+    r->recording = false;
+    if (r->full)
+        return -1;
+    if (r->fill)
+        put_page(r);
+    if (r->full)
+        return -1;
+    xvc_rec_header_t h = {XVC_REC_MAGIC, XVC_REC_VERSION, r->records, r->off, r->start};
+    memset(r->page, 0xff, sizeof(r->page));
+    memcpy(r->page, &h, sizeof(h));
+    if (r->store->program(0, r->page, XVC_REC_PAGE) < 0)
+        return -1;
+    DLOG2(REC_STOP, r->records, r->off);
+    return r->records;
+}
+
+int xvc_rec_replay(xvc_rec_t *r, uint32_t *mismatches)
+{
+    const xvc_rec_header_t *h = (const xvc_rec_header_t *)r->store->base;
+    const xvc_backend_t *l = r->lower;
+    *mismatches = 0;
+    if (r->recording || h->magic != XVC_REC_MAGIC || h->version != XVC_REC_VERSION ||
+        XVC_REC_PAGE + h->bytes > r->store->size || h->start >= JTAG_STATE_COUNT)
+        return -1;
+
+    const uint32_t *p = (const uint32_t *)(r->store->base + XVC_REC_PAGE);
+    const uint32_t *end = p + h->bytes / 4;
+    uint32_t done = 0;
+    // five TMS=1 to Test-Logic-Reset, then the walk to where recording began
+    const jtag_path_t *walk = &jtag_paths[JTAG_TEST_LOGIC_RESET][h->start];
+    const uint32_t start_tms = 0x1fu | (uint32_t)walk->tms << 5, start_tdi = 0;
+    if (l->shift(l->ctx, &start_tms, &start_tdi, r->tdo, 5 + walk->len) < 0)
+    {
+        DLOG1(REC_REPLAY_ERR, 0);
+        return -1;
+    }
+    while (done < h->records && p < end)
+    {
+        int nbits = (int)p[0];
+        uint32_t words = (nbits + 31) / 32;
+        if (nbits <= 0 || words > XVC_VECTOR_WORDS || p + 1 + 3 * words > end)
+            return -1;
+        const uint32_t *tms = p + 1, *tdi = tms + words, *expect = tdi + words;
+        if (l->shift(l->ctx, tms, tdi, r->tdo, nbits) < 0)
+        {
+            DLOG1(REC_REPLAY_ERR, done);
+            return -1;
+        }
+        if (nbits % 32)
+            r->tdo[words - 1] &= (1u << (nbits % 32)) - 1;
+        if (memcmp(r->tdo, expect, words * 4))
+            (*mismatches)++;
+        p = expect + words;
+        done++;
+    }
+    DLOG2(REC_REPLAY, done, *mismatches);
+    return done;
+}
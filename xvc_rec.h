@@ -0,0 +1,75 @@
+#ifndef __XVC_REC_H__
+#define __XVC_REC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "xvc_backend.h"
+#include "xvc_server.h"
+#include "tap_track.h"
+
+// Session recorder: while recording, every shift that passes through is
+// appended to flash with the TDO the chain returned. Replay streams the
+// TMS/TDI words straight from the memory mapped store into the lower backend
+// and compares TDO against the recording, no host needed.
+//
+// Store layout: page 0 holds the header, written when recording stops, so
+// an interrupted recording never replays. Records follow from page 1:
+//   uint32_t nbits, then ceil(nbits / 32) words each of tms, tdi and tdo.
+// The whole store is erased when recording starts, a flash erase stops the
+// CPU for tens of ms and must not land between the shifts of a session.
+
+#define XVC_REC_MAGIC 0x52435658 // "XVCR"
+#define XVC_REC_VERSION 2
+#define XVC_REC_PAGE 256    // program granularity
+#define XVC_REC_BLOCK 65536 // erased at a time, blocks already blank are skipped
+
+typedef struct xvc_rec_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t records;
+    uint32_t bytes; // record data after the header page
+    uint32_t start; // jtag_state_t the TAP was in at rec:1, replay walks there
+} xvc_rec_header_t;
+
+// erase and program take offsets into the store and return 0, or -1 when the
+// flash could not be written; reads go through base
+typedef struct xvc_rec_store
+{
+    const uint8_t *base;
+    uint32_t size;
+    int (*erase)(uint32_t off, uint32_t len);
+    int (*program)(uint32_t off, const void *data, uint32_t len);
+} xvc_rec_store_t;
+
+typedef struct xvc_rec
+{
+    xvc_backend_t backend; // ctx points back here
+    const xvc_backend_t *lower;
+    const xvc_rec_store_t *store;
+    // optional, the tracker below: recording only starts in a known state.
+    // Without one recordings are taken to start in Test-Logic-Reset
+    const tap_track_t *track;
+    jtag_state_t start;
+    bool recording;
+    bool full; // ran out of store or a write failed, the recording is dropped at stop
+    uint32_t records;
+    uint32_t off;  // record bytes written to the store
+    uint32_t fill; // bytes waiting in page
+    uint32_t page[XVC_REC_PAGE / 4];
+    uint32_t tdo[XVC_VECTOR_WORDS + 1];
+} xvc_rec_t;
+
+void xvc_rec_init(xvc_rec_t *r, const xvc_backend_t *lower, const xvc_rec_store_t *store);
+// erases the store, 0 or -1 when it could not be erased or the tracker does
+// not know the TAP state
+int xvc_rec_start(xvc_rec_t *r);
+// returns the number of records kept, -1 if the store overflowed
+int xvc_rec_stop(xvc_rec_t *r);
+// resets the TAP, walks to the start state and replays; returns the number
+// of records replayed and the ones with a TDO mismatch, -1 when there is no
+// valid recording, it is being recorded or a shift failed
+int xvc_rec_replay(xvc_rec_t *r, uint32_t *mismatches);
+
+#endif
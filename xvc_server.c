@@ -0,0 +1,331 @@
+#include "xvc_server.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "xvc_rec.h"
+#include "xvc_verify.h"
+#include "dlog.h"
+
+enum
+{
+    XVC_RD_CMD,  // two byte command prefix
+    XVC_RD_ARGS, // rest of the command and its fixed size arguments
+    XVC_RD_TMS,
+    XVC_RD_TDI,
+    XVC_RD_Z, // shiftz: payload
+    XVC_RD_EXPECT, // shiftv: expected tdo
+    XVC_RD_MASK,
+};
+
+static int sent(int n, int len)
+{
+    if (n == len)
+        return 0;
+    DLOG2(XVC_SEND_ERR, len, n);
+    return 1;
+}
+
+static int swrite(const xvc_transport_t *t, const void *data, int len)
+{
+    return sent(t->write(t->ctx, data, len), len);
+}
+
+static void expect(xvc_conn_t *c, int state, void *dst, int need)
+{
+    c->state = state;
+    c->dst = dst;
+    c->need = need;
+    c->got = 0;
+}
+
+void xvc_server_init(xvc_server_t *srv, const xvc_backend_t *backend)
+{
+    memset(srv, 0, sizeof(*srv));
+    srv->backend = backend;
+}
+
+void xvc_conn_init(xvc_conn_t *c)
+{
+    c->codec = 0;
+    expect(c, XVC_RD_CMD, c->hdr, 2);
+}
+
+// bytes that follow the two byte prefix, 0 for an unknown command
+static int args_len(const xvc_server_t *srv, const uint8_t *cmd)
+{
+    if (memcmp(cmd, "ge", 2) == 0)
+        return 6; // tinfo:
+    if (memcmp(cmd, "se", 2) == 0)
+        return 9; // ttck: period
+    if (memcmp(cmd, "st", 2) == 0)
+        return 4; // ats:
+    if (memcmp(cmd, "sh", 2) == 0)
+        return 8; // ift: len, or iftz: (iftv:, iftc:) and the first 3 bytes of len
+    if (memcmp(cmd, "co", 2) == 0)
+        return 5; // dec: codec
+    if (srv->rec && (memcmp(cmd, "re", 2) == 0 || memcmp(cmd, "pl", 2) == 0))
+        return 3; // c: on/off, ay:
+    if (srv->calibrate && memcmp(cmd, "ca", 2) == 0)
+        return 4; // lib:
+    return 0;
+}
+
+// runs a command once its arguments are in, returns 1 to close
+static int command(xvc_server_t *srv, xvc_conn_t *c, const xvc_transport_t *t)
+{
+    const xvc_backend_t *b = srv->backend;
+    const uint8_t *cmd = c->hdr;
+
+    // shiftz: has 5 more argument bytes than shift:, shiftv: and shiftc: 1
+    if (memcmp(cmd, "shift", 5) == 0 && cmd[5] != ':' && c->dst == c->hdr + 2)
+    {
+        expect(c, XVC_RD_ARGS, c->hdr + 10, cmd[5] == 'z' ? 5 : 1);
+        return 0;
+    }
+    expect(c, XVC_RD_CMD, c->hdr, 2);
+    if (memcmp(cmd, "ge", 2) == 0)
+    {
+        char info[32];
+        int n = snprintf(info, sizeof(info), "xvcServer_v1.0:%d\n", XVC_BUFFER_SIZE);
+        return swrite(t, info, n);
+    }
+    else if (memcmp(cmd, "se", 2) == 0)
+    {
+        uint32_t period;
+        memcpy(&period, cmd + 7, 4);
+        if (b->set_tck)
+            period = b->set_tck(b->ctx, period);
+        return swrite(t, &period, 4);
+    }
+    else if (memcmp(cmd, "st", 2) == 0)
+    {
+        // stats: -> 4 byte length + histogram text, the histograms are reset
+        static char text[1024];
+        int n = xvc_stats_dump(text, sizeof(text), true);
+        return swrite(t, &n, 4) || swrite(t, text, n);
+    }
+    else if (memcmp(cmd, "ca", 2) == 0)
+    {
+        // calib: -> 4 byte length + thresholds and usage text
+        static char text[8192];
+        int n = srv->calibrate(text, sizeof(text));
+        return swrite(t, &n, 4) || swrite(t, text, n);
+    }
+    else if (memcmp(cmd, "re", 2) == 0)
+    {
+        // rec:<1 byte> 1 starts recording -> 0 or -1, 0 stops -> 4 byte records kept or -1
+        int32_t n = 0;
+        if (cmd[4])
+            n = xvc_rec_start(srv->rec);
+        else
+            n = xvc_rec_stop(srv->rec);
+        return swrite(t, &n, 4);
+    }
+    else if (memcmp(cmd, "co", 2) == 0)
+    {
+        // codec:<1 byte> asks for a shiftz: codec -> 1 byte, the codec in use
+        // from now on, 0 for none
+        c->codec = cmd[6] == XVC_Z_RLE ? XVC_Z_RLE : 0;
+        return swrite(t, &c->codec, 1);
+    }
+    else if (memcmp(cmd, "pl", 2) == 0)
+    {
+        // play: -> 4 byte records replayed or -1, 4 byte records with a tdo mismatch
+        int32_t res[2];
+        uint32_t bad;
+        res[0] = xvc_rec_replay(srv->rec, &bad);
+        res[1] = (int32_t)bad;
+        return swrite(t, res, 8);
+    }
+
+    // shift: | len 4 bytes | nr_bytes tms | nr_bytes tdi
+    // shiftz: | len 4 bytes | zlen 4 bytes | zlen bytes, tms and tdi each coded
+    // shiftv: | len 4 bytes | nr_bytes tms | nr_bytes tdi | nr_bytes expected tdo | nr_bytes mask
+    // shiftc: | len 4 bytes | nr_bytes tms | nr_bytes tdi
+    c->kind = cmd[5];
+    bool ext = c->kind == 'z' || c->kind == 'v' || c->kind == 'c';
+    if (c->kind != ':' && (!ext || cmd[6] != ':'))
+    {
+        DLOG2(XVC_BAD_CMD, cmd[5], cmd[6]);
+        return 1;
+    }
+    memcpy(&c->len, cmd + 6 + ext, 4);
+    // checked before any arithmetic, the length comes off the wire
+    if (c->len <= 0 || c->len > XVC_BUFFER_SIZE / 2 * 8)
+    {
+        DLOG1(XVC_BAD_LEN, c->len);
+        return 1;
+    }
+    int nr_bytes = (c->len + 7) / 8;
+    if (c->kind == 'z')
+    {
+        memcpy(&c->zlen, cmd + 11, 4);
+        // not negotiated on this connection, or more than the buffer
+        if (!c->codec || c->zlen <= 0 || c->zlen > (int)sizeof(c->aux))
+        {
+            DLOG2(XVC_BAD_Z, c->len, c->zlen);
+            return 1;
+        }
+        expect(c, XVC_RD_Z, c->aux, c->zlen);
+        return 0;
+    }
+    // the vectors are read straight into the word buffers
+    expect(c, XVC_RD_TMS, c->tms, nr_bytes);
+    return 0;
+}
+
+// shiftv: and shiftc: reply with 4 bytes instead of the tdo: the first bit
+// that failed the compare or -1, or the CRC-32 of the tdo words
+static int check(xvc_server_t *srv, xvc_conn_t *c, const xvc_transport_t *t)
+{
+    int nr_bytes = (c->len + 7) / 8, words = (c->len + 31) / 32;
+    uint32_t res;
+    if (c->kind == 'v')
+    {
+        int bad = xvc_verify_compare(srv->tdo, c->aux, c->aux + XVC_VECTOR_WORDS, c->len);
+        res = (uint32_t)bad;
+        xvc_counters.verify_shifts++;
+        xvc_counters.verify_fails += bad >= 0;
+    }
+    else
+    {
+        res = srv->crc32 ? srv->crc32(srv->tdo, words) : xvc_crc32(srv->tdo, words * 4);
+        xvc_counters.crc_shifts++;
+    }
+    if (swrite(t, &res, 4))
+        return 1;
+    xvc_stats_mark(&c->probe, XVC_PHASE_COUNT);
+    int rx = 11 + (c->kind == 'v' ? 4 : 2) * nr_bytes;
+    xvc_stats_record(&c->probe, c->len, rx, 4);
+    xvc_counters.check_tdo_bytes += nr_bytes;
+    DLOG2(XVC_SHIFT, c->len, (uint32_t)(c->probe.t[XVC_PHASE_WRITE] - c->probe.t[XVC_PHASE_SHIFT]));
+    return 0;
+}
+
+static int shift(xvc_server_t *srv, xvc_conn_t *c, const xvc_transport_t *t)
+{
+    const xvc_backend_t *b = srv->backend;
+    int nr_bytes = (c->len + 7) / 8;
+    uint32_t *tdo = NULL;
+
+    // a plain reply is shifted straight into a buffer the transport sends
+    // from, the checks read srv->tdo
+    if (c->kind == ':' && t->lend)
+        tdo = t->lend(t->ctx, nr_bytes);
+    if (!tdo)
+        tdo = srv->tdo;
+    expect(c, XVC_RD_CMD, c->hdr, 2);
+    xvc_stats_mark(&c->probe, XVC_PHASE_COPY);
+    xvc_stats_mark(&c->probe, XVC_PHASE_SHIFT);
+    int r = b->shift(b->ctx, c->tms, c->tdi, tdo, c->len);
+    if (r < 0)
+    {
+        // XVC 1.0 has no error reply, dropping the connection is the error
+        DLOG2(XVC_SHIFT_ERR, c->len, r);
+        return 1;
+    }
+    xvc_stats_mark(&c->probe, XVC_PHASE_WRITE);
+    if (c->kind != ':')
+        return check(srv, c, t);
+    if (tdo == srv->tdo ? swrite(t, tdo, nr_bytes) : sent(t->send_lent(t->ctx, tdo, nr_bytes), nr_bytes))
+        return 1;
+    xvc_stats_mark(&c->probe, XVC_PHASE_COUNT);
+    xvc_stats_record(&c->probe, c->len, 10 + 2 * nr_bytes, nr_bytes);
+    DLOG2(XVC_SHIFT, c->len, (uint32_t)(c->probe.t[XVC_PHASE_WRITE] - c->probe.t[XVC_PHASE_SHIFT]));
+    return 0;
+}
+
+// shiftz: the payload is decoded straight into the word buffers the backend
+// shifts from, the copy phase is the decode; the tdo reply is coded the same way
+static int shiftz(xvc_server_t *srv, xvc_conn_t *c, const xvc_transport_t *t)
+{
+    const xvc_backend_t *b = srv->backend;
+    int nr_bytes = (c->len + 7) / 8;
+
+    expect(c, XVC_RD_CMD, c->hdr, 2);
+    xvc_stats_mark(&c->probe, XVC_PHASE_COPY);
+    const uint8_t *z = (const uint8_t *)c->aux;
+    int k = xvc_z_decode((uint8_t *)c->tms, nr_bytes, z, c->zlen);
+    if (k < 0 || xvc_z_decode((uint8_t *)c->tdi, nr_bytes, z + k, c->zlen - k) != c->zlen - k)
+    {
+        DLOG2(XVC_BAD_Z, c->len, c->zlen);
+        return 1;
+    }
+    xvc_stats_mark(&c->probe, XVC_PHASE_SHIFT);
+    int r = b->shift(b->ctx, c->tms, c->tdi, srv->tdo, c->len);
+    if (r < 0)
+    {
+        DLOG2(XVC_SHIFT_ERR, c->len, r);
+        return 1;
+    }
+    xvc_stats_mark(&c->probe, XVC_PHASE_WRITE);
+    int32_t zlen = xvc_z_encode(srv->ztdo + 4, sizeof(srv->ztdo) - 4, (const uint8_t *)srv->tdo, nr_bytes);
+    memcpy(srv->ztdo, &zlen, 4);
+    if (swrite(t, srv->ztdo, 4 + zlen))
+        return 1;
+    xvc_stats_mark(&c->probe, XVC_PHASE_COUNT);
+    xvc_stats_record(&c->probe, c->len, 15 + c->zlen, 4 + zlen);
+    xvc_counters.z_shifts++;
+    xvc_counters.z_raw_bytes += 10 + 3 * nr_bytes;
+    xvc_counters.z_wire_bytes += 15 + c->zlen + 4 + zlen;
+    DLOG2(XVC_SHIFT, c->len, (uint32_t)(c->probe.t[XVC_PHASE_WRITE] - c->probe.t[XVC_PHASE_SHIFT]));
+    return 0;
+}
+
+int xvc_server_feed(xvc_server_t *srv, xvc_conn_t *c, const xvc_transport_t *t)
+{
+    while (1)
+    {
+        if (c->got < c->need)
+        {
+            int r = t->read(t->ctx, c->dst + c->got, c->need - c->got);
+            if (r < 0)
+                return 1;
+            if (r == 0)
+                return 0;
+            c->got += r;
+            continue;
+        }
+
+        int close = 0;
+        switch (c->state)
+        {
+        case XVC_RD_CMD:
+        {
+            int n = args_len(srv, c->hdr);
+            if (!n)
+            {
+                DLOG2(XVC_BAD_CMD, c->hdr[0], c->hdr[1]);
+                return 1;
+            }
+            if (memcmp(c->hdr, "sh", 2) == 0)
+                xvc_stats_mark(&c->probe, XVC_PHASE_READ);
+            expect(c, XVC_RD_ARGS, c->hdr + 2, n);
+            break;
+        }
+        case XVC_RD_ARGS:
+            close = command(srv, c, t);
+            break;
+        case XVC_RD_TMS:
+            expect(c, XVC_RD_TDI, c->tdi, c->need);
+            break;
+        case XVC_RD_TDI:
+            if (c->kind == 'v')
+                expect(c, XVC_RD_EXPECT, c->aux, c->need);
+            else
+                close = shift(srv, c, t);
+            break;
+        case XVC_RD_EXPECT:
+            expect(c, XVC_RD_MASK, c->aux + XVC_VECTOR_WORDS, c->need);
+            break;
+        case XVC_RD_MASK:
+            close = shift(srv, c, t);
+            break;
+        case XVC_RD_Z:
+            close = shiftz(srv, c, t);
+            break;
+        }
+        if (close)
+            return 1;
+    }
+}
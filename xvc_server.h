@@ -0,0 +1,81 @@
+#ifndef __XVC_SERVER_H__
+#define __XVC_SERVER_H__
+
+#include <stdint.h>
+
+#include "xvc_backend.h"
+#include "xvc_stats.h"
+#include "xvc_z.h"
+
+// advertised by getinfo:, tms + tdi bytes of the largest shift
+#define XVC_BUFFER_SIZE 2048
+#define XVC_VECTOR_WORDS (XVC_BUFFER_SIZE / 2 / 4)
+// clients served at the same time, their shifts interleave on the chain
+#ifndef XVC_MAX_CONN
+#define XVC_MAX_CONN 2
+#endif
+
+// every client is served by one task: a reply that has not left after this
+// long closes its connection, so a client that stops reading cannot stall
+// the others
+#define XVC_SEND_TIMEOUT_MS 2000
+
+// one client connection. read must not block: it returns the bytes it got,
+// 0 when nothing is available yet and < 0 once the peer closed or failed.
+// write behaves like the socket call with a send timeout of
+// XVC_SEND_TIMEOUT_MS, anything short of len closes the connection.
+// lend and send_lent are optional and go together, for shift: replies
+// without a copy: lend returns a word aligned buffer of at least len bytes
+// that no queued reply still uses, NULL when every one does, and send_lent
+// queues a reply from it as write would, the buffer staying the transport's
+// until the peer acknowledged it.
+typedef struct xvc_transport
+{
+    void *ctx;
+    int (*read)(void *ctx, void *buf, int len);
+    int (*write)(void *ctx, const void *buf, int len);
+    void *(*lend)(void *ctx, int len);
+    int (*send_lent)(void *ctx, const void *buf, int len);
+} xvc_transport_t;
+
+struct xvc_rec;
+
+typedef struct xvc_server
+{
+    const xvc_backend_t *backend;
+    struct xvc_rec *rec; // optional, serves rec: and play:
+    // optional, serves calib: by re-measuring the shift paths into text
+    int (*calibrate)(char *text, int size);
+    // optional, CRC-32 of the tdo words for shiftc: on other hardware than
+    // the CPU (the DMA sniffer), xvc_crc32() otherwise
+    uint32_t (*crc32)(const uint32_t *words, int nwords);
+    uint32_t tdo[XVC_VECTOR_WORDS];
+    uint8_t ztdo[4 + XVC_Z_BOUND(XVC_BUFFER_SIZE / 2)]; // shiftz: reply
+} xvc_server_t;
+
+// parser state of one connection, a command may arrive in any number of pieces
+typedef struct xvc_conn
+{
+    uint8_t state;
+    uint8_t codec;   // agreed with codec:, 0 until then
+    uint8_t kind;    // of the shift being read: ':', or 'z', 'v', 'c' of shiftz: etc.
+    uint8_t hdr[16]; // command prefix and fixed arguments
+    uint8_t *dst;    // where the bytes of the current field go
+    int need, got;
+    int len;  // shift: bits
+    int zlen; // shiftz: payload bytes
+    xvc_stats_probe_t probe;
+    uint32_t tms[XVC_VECTOR_WORDS];
+    uint32_t tdi[XVC_VECTOR_WORDS];
+    // shiftz: payload, or the expected tdo and mask of shiftv:, a vector each
+    uint32_t aux[2 * XVC_VECTOR_WORDS];
+} xvc_conn_t;
+
+void xvc_server_init(xvc_server_t *srv, const xvc_backend_t *backend);
+// a new connection, compression off
+void xvc_conn_init(xvc_conn_t *c);
+// consumes what t has available and runs the commands it completes, returns
+// 0 to go back to select() and 1 when the connection should be closed
+int xvc_server_feed(xvc_server_t *srv, xvc_conn_t *c, const xvc_transport_t *t);
+
+#endif
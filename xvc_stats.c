@@ -0,0 +1,78 @@
+#include "xvc_stats.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *const phase_name[XVC_PHASE_COUNT] = {"read", "copy", "shift", "write"};
+static const int len_class_max[XVC_STATS_LEN_CLASSES - 1] = {32, 256, 2048, 16384};
+
+static uint32_t histo[XVC_STATS_LEN_CLASSES][XVC_PHASE_COUNT][XVC_STATS_BUCKETS];
+static uint64_t histo_since;
+
+xvc_counters_t xvc_counters;
+
+static int len_class(int nbits)
+{
+    int i;
+    for (i = 0; i < XVC_STATS_LEN_CLASSES - 1; i++)
+    {
+        if (nbits <= len_class_max[i])
+            break;
+    }
+    return i;
+}
+
+static int us_bucket(uint64_t us)
+{
+    if (us == 0)
+        return 0;
+    if (us >= (1u << (XVC_STATS_BUCKETS - 2)))
+        return XVC_STATS_BUCKETS - 1;
+    return 32 - __builtin_clz((uint32_t)us);
+}
+
+void xvc_stats_record(const xvc_stats_probe_t *probe, int nbits, int rx, int tx)
+{
+    uint32_t(*h)[XVC_STATS_BUCKETS] = histo[len_class(nbits)];
+    for (int i = 0; i < XVC_PHASE_COUNT; i++)
+        h[i][us_bucket(probe->t[i + 1] - probe->t[i])]++;
+
+    xvc_counters.shifts++;
+    xvc_counters.shift_bits += nbits;
+    xvc_counters.shift_us += probe->t[XVC_PHASE_WRITE] - probe->t[XVC_PHASE_SHIFT];
+    xvc_counters.rx_bytes += rx;
+    xvc_counters.tx_bytes += tx;
+}
+
+void xvc_stats_reset(void)
+{
+    memset(histo, 0, sizeof(histo));
+    histo_since = time_us_64();
+}
+
+int xvc_stats_dump(char *buf, int size, bool reset)
+{
+    int n = snprintf(buf, size, "# shift phase histograms, log2 us buckets, %llu us\n",
+                     (unsigned long long)(time_us_64() - histo_since));
+    for (int c = 0; c < XVC_STATS_LEN_CLASSES && n < size; c++)
+    {
+        for (int p = 0; p < XVC_PHASE_COUNT && n < size; p++)
+        {
+            uint32_t total = 0;
+            for (int b = 0; b < XVC_STATS_BUCKETS; b++)
+                total += histo[c][p][b];
+            if (!total)
+                continue;
+            if (c < XVC_STATS_LEN_CLASSES - 1)
+                n += snprintf(buf + n, size - n, "<=%d %s", len_class_max[c], phase_name[p]);
+            else
+                n += snprintf(buf + n, size - n, ">%d %s", len_class_max[c - 1], phase_name[p]);
+            for (int b = 0; b < XVC_STATS_BUCKETS && n < size; b++)
+                n += snprintf(buf + n, size - n, " %lu", (unsigned long)histo[c][p][b]);
+            if (n < size)
+                n += snprintf(buf + n, size - n, "\n");
+        }
+    }
+    if (reset)
+        xvc_stats_reset();
+    return n < size ? n : size - 1;
+}
@@ -0,0 +1,89 @@
+#ifndef __XVC_STATS_H__
+#define __XVC_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef XVC_HOST
+#include <time.h>
+static inline uint64_t time_us_64(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+#else
+#include "pico/time.h"
+#endif
+
+// phases of one shift: command payload read, copy into the tx buffers,
+// pio_xfer_rw and the tdo write back to the socket
+typedef enum xvc_phase
+{
+    XVC_PHASE_READ,
+    XVC_PHASE_COPY,
+    XVC_PHASE_SHIFT,
+    XVC_PHASE_WRITE,
+    XVC_PHASE_COUNT
+} xvc_phase_t;
+
+// shift length classes, upper bound in bits: 32, 256, 2048, 16384, more
+#define XVC_STATS_LEN_CLASSES 5
+// log2 microsecond buckets: [0]=0us, [1]=1us, [2]=2-3us ... [15]>=16ms
+#define XVC_STATS_BUCKETS 16
+
+typedef struct xvc_stats_probe
+{
+    uint64_t t[XVC_PHASE_COUNT + 1]; // time_us_64() at each phase boundary
+} xvc_stats_probe_t;
+
+static inline void xvc_stats_mark(xvc_stats_probe_t *probe, int phase)
+{
+    probe->t[phase] = time_us_64();
+}
+
+// running totals for the metrics endpoint, each field has a single writer
+typedef struct xvc_counters
+{
+    uint32_t usb_rx_frames;
+    uint32_t usb_rx_drops;
+    uint32_t usb_rx_held; // frames that waited in the endpoint for a pbuf
+    uint32_t usb_rx_csum_drops; // tcp checksum failed in xvc_frame_copy()
+    uint64_t usb_rx_copy_bytes; // frames copied out of the usb buffer
+    uint64_t sock_rx_bytes;     // read by the xvc server, the last copy
+    uint64_t sock_tx_bytes;      // written by the xvc server
+    uint64_t sock_tx_copy_bytes; // of those, copied into lwIP (not lent)
+    uint32_t tx_lent_busy;       // shift: replies copied, every lent buffer unacknowledged
+    uint64_t usb_tx_copy_bytes; // frames gathered into the usb buffer
+    uint32_t usb_tx_frames;
+    uint32_t shifts;
+    uint64_t shift_bits;
+    uint64_t shift_us; // time spent in pio_xfer_rw
+    uint64_t rx_bytes; // shift: and shiftz: commands, header included
+    uint64_t tx_bytes; // tdo replies
+    uint32_t z_shifts; // shiftz: (xvc_z.h)
+    uint64_t z_raw_bytes;  // what they would have been as shift:
+    uint64_t z_wire_bytes; // and were
+    uint32_t verify_shifts; // shiftv: (xvc_verify.h)
+    uint32_t verify_fails;
+    uint32_t crc_shifts; // shiftc:
+    uint64_t check_tdo_bytes; // tdo of both that stayed on the probe
+    uint32_t idle_runs; // runs clocked by the idle program (tap_track.c)
+    uint64_t idle_bits;
+    uint32_t rle_runs; // repeat segments (tdi_rle.c)
+    uint64_t rle_bits;
+    uint64_t rle_words_saved; // tx fifo words not pushed thanks to repeats
+    uint32_t shift_timeouts; // stalled shifts, the state machines were reset
+    uint32_t irq_shifts; // shifts fed by the pio fifo interrupt (pio_xfer.c)
+    uint32_t pio_irqs;
+} xvc_counters_t;
+
+extern xvc_counters_t xvc_counters;
+
+// rx and tx are the command and reply bytes on the wire
+void xvc_stats_record(const xvc_stats_probe_t *probe, int nbits, int rx, int tx);
+// prints the histograms as text into buf and returns the length, reset clears them
+int xvc_stats_dump(char *buf, int size, bool reset);
+void xvc_stats_reset(void);
+
+#endif
@@ -0,0 +1,33 @@
+#include "xvc_verify.h"
+
+int xvc_verify_compare(const uint32_t *tdo, const uint32_t *expect, const uint32_t *mask, int nbits)
+{
+    int words = (nbits + 31) / 32;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t m = w == words - 1 && nbits % 32 ? (1u << (nbits % 32)) - 1 : 0xffffffffu;
+        uint32_t d = (tdo[w] ^ expect[w]) & mask[w] & m;
+        if (d)
+            return w * 32 + __builtin_ctz(d);
+    }
+    return -1;
+}
+
+// reflected polynomial 0xedb88320, 4 bits at a time: 64 bytes of table
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t xvc_crc32(const void *data, int len)
+{
+    const uint8_t *p = data;
+    uint32_t crc = 0xffffffffu;
+    for (int i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        crc = crc >> 4 ^ crc_nibble[crc & 15];
+        crc = crc >> 4 ^ crc_nibble[crc & 15];
+    }
+    return ~crc;
+}
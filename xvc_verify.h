@@ -0,0 +1,26 @@
+#ifndef __XVC_VERIFY_H__
+#define __XVC_VERIFY_H__
+
+#include <stdint.h>
+
+// TDO checks of the shiftv: and shiftc: extensions, done next to the chain so
+// only the verdict crosses the wire: a compare against an expected vector and
+// a mask, or a CRC-32 the host compares with its own. The CRC is zlib's
+// crc32() over the TDO words as little endian bytes, the bits above nbits
+// zero, which is what the RP2040 DMA sniffer computes over a word stream.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// first bit where tdo differs from expect and mask is 1, -1 when none does;
+// bits above nbits are ignored in all three
+int xvc_verify_compare(const uint32_t *tdo, const uint32_t *expect, const uint32_t *mask, int nbits);
+// CRC-32 in software, one 16 entry table lookup per nibble
+uint32_t xvc_crc32(const void *data, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
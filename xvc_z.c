@@ -0,0 +1,75 @@
+#include "xvc_z.h"
+#include <string.h>
+
+#define MAX_LIT 128
+#define MIN_RUN 3
+#define MAX_RUN (0x7f + MIN_RUN)
+
+static int literal(uint8_t *dst, int cap, int o, const uint8_t *src, int n)
+{
+    while (n > 0)
+    {
+        int k = n < MAX_LIT ? n : MAX_LIT;
+        if (o + 1 + k > cap)
+            return -1;
+        dst[o++] = (uint8_t)(k - 1);
+        memcpy(dst + o, src, k);
+        o += k;
+        src += k;
+        n -= k;
+    }
+    return o;
+}
+
+int xvc_z_encode(uint8_t *dst, int cap, const uint8_t *src, int n)
+{
+    int o = 0, lit = 0, i = 0;
+    while (i < n && o >= 0)
+    {
+        int run = 1;
+        while (i + run < n && run < MAX_RUN && src[i + run] == src[i])
+            run++;
+        if (run < MIN_RUN)
+        {
+            i += run;
+            continue;
+        }
+        o = literal(dst, cap, o, src + lit, i - lit);
+        if (o < 0 || o + 2 > cap)
+            return -1;
+        dst[o++] = (uint8_t)(0x80 + run - MIN_RUN);
+        dst[o++] = src[i];
+        i += run;
+        lit = i;
+    }
+    return o < 0 ? -1 : literal(dst, cap, o, src + lit, n - lit);
+}
+
+int xvc_z_decode(uint8_t *dst, int n, const uint8_t *src, int len)
+{
+    int i = 0, o = 0;
+    while (o < n)
+    {
+        if (i >= len)
+            return -1;
+        int c = src[i++];
+        if (c < 0x80)
+        {
+            int k = c + 1;
+            if (i + k > len || o + k > n)
+                return -1;
+            memcpy(dst + o, src + i, k);
+            i += k;
+            o += k;
+        }
+        else
+        {
+            int k = c - 0x80 + MIN_RUN;
+            if (i >= len || o + k > n)
+                return -1;
+            memset(dst + o, src[i++], k);
+            o += k;
+        }
+    }
+    return i;
+}
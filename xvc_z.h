@@ -0,0 +1,30 @@
+#ifndef __XVC_Z_H__
+#define __XVC_Z_H__
+
+#include <stdint.h>
+
+// Byte run-length code of the shiftz: extension (PackBits with runs of 3 to
+// 130): a control byte c < 0x80 is followed by c + 1 literal bytes, c >= 0x80
+// by one byte that repeats c - 0x80 + 3 times. Bitstreams, blank frames and
+// the TMS of long shifts are mostly runs; a decoder needs no tables and
+// writes runs with memset, cheap enough for the M0+.
+
+#define XVC_Z_RLE 1 // codec number negotiated with codec:
+// longest encoding of n bytes, all literals
+#define XVC_Z_BOUND(n) ((n) + ((n) + 127) / 128)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// encodes n bytes into dst, returns the length or -1 when cap is too small
+int xvc_z_encode(uint8_t *dst, int cap, const uint8_t *src, int n);
+// decodes from src until exactly n bytes are out, returns the bytes of src
+// used, -1 when the code is malformed, runs past len or past n
+int xvc_z_decode(uint8_t *dst, int n, const uint8_t *src, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif